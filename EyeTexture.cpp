@@ -0,0 +1,34 @@
+#include "EyeTexture.hpp"
+
+// Normalized device depth of a point straight ahead at distance, tracking space looks down -z
+static float ProjectDepth(const vr::HmdMatrix44_t& projection, float distance) {
+	float z = projection.m[2][2] * -distance + projection.m[2][3];
+	float w = projection.m[3][2] * -distance + projection.m[3][3];
+	return z / w;
+}
+
+vr::HmdVector2_t DepthRange(const vr::HmdMatrix44_t& projection, float nearClip, float farClip) {
+	vr::HmdVector2_t range;
+	range.v[0] = ProjectDepth(projection, nearClip);
+	range.v[1] = ProjectDepth(projection, farClip);
+	return range;
+}
+
+vr::EVRSubmitFlags EyeTexture(vr::VRTextureWithPoseAndDepth_t& texture, vr::VRVulkanTextureData_t* color, vr::VRVulkanTextureData_t* depth,
+	const vr::HmdMatrix34_t& pose, const vr::HmdMatrix44_t& projection, float nearClip, float farClip) {
+	texture = {};
+	texture.handle = color;
+	texture.eType = vr::TextureType_Vulkan;
+	texture.eColorSpace = vr::ColorSpace_Gamma;
+	// The exact pose the eye was rendered with, so the compositor doesn't have to guess when reprojecting
+	texture.mDeviceToAbsoluteTracking = pose;
+
+	uint32_t flags = vr::Submit_TextureWithPose;
+	if (depth) {
+		texture.depth.handle = depth;
+		texture.depth.mProjection = projection;
+		texture.depth.vRange = DepthRange(projection, nearClip, farClip);
+		flags |= vr::Submit_TextureWithDepth;
+	}
+	return (vr::EVRSubmitFlags)flags;
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <openvr.h>
+
+// The depth buffer values that the near and far planes land on under projection, which is what the compositor expects
+// in VRTextureDepthInfo_t::vRange. 0..1 for a standard projection, 1..0 for a reversed-Z one
+vr::HmdVector2_t DepthRange(const vr::HmdMatrix44_t& projection, float nearClip, float farClip);
+
+// Describes one eye to the compositor: the pose it was rendered with and, when there is a depth texture, the projection
+// and depth range it was rendered with. Returns the submit flags that go with the description
+vr::EVRSubmitFlags EyeTexture(vr::VRTextureWithPoseAndDepth_t& texture, vr::VRVulkanTextureData_t* color, vr::VRVulkanTextureData_t* depth,
+	const vr::HmdMatrix34_t& pose, const vr::HmdMatrix44_t& projection, float nearClip, float farClip);
\ No newline at end of file
@@ -0,0 +1,8 @@
+#include "HmdDevice.hpp"
+
+HmdDeviceCheck CheckHmdDevice(VkPhysicalDevice device, const std::function<VkPhysicalDevice()>& outputDevice, bool require, VkPhysicalDevice& hmdDevice) {
+	hmdDevice = outputDevice();
+	if (hmdDevice == VK_NULL_HANDLE) return HMD_DEVICE_UNKNOWN;
+	if (hmdDevice == device) return HMD_DEVICE_MATCH;
+	return require ? HMD_DEVICE_REFUSED : HMD_DEVICE_MISMATCH;
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <functional>
+
+enum HmdDeviceCheck {
+	HMD_DEVICE_MATCH,		// The engine renders on the GPU driving the HMD
+	HMD_DEVICE_UNKNOWN,		// The runtime doesn't say which GPU drives the HMD
+	HMD_DEVICE_MISMATCH,	// Another GPU drives the HMD, startup goes on with a warning
+	HMD_DEVICE_REFUSED,		// Another GPU drives the HMD, and the same GPU is required
+};
+
+// Compares the GPU the engine picked with the one outputDevice reports for the HMD, which is also returned in hmdDevice
+HmdDeviceCheck CheckHmdDevice(VkPhysicalDevice device, const std::function<VkPhysicalDevice()>& outputDevice, bool require, VkPhysicalDevice& hmdDevice);
\ No newline at end of file
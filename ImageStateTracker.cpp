@@ -0,0 +1,93 @@
+#include "ImageStateTracker.hpp"
+
+using namespace std;
+
+static const VkAccessFlags gWriteAccess =
+	VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+	VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+ImageStateTracker::ImageStateTracker() : mSrcStage(0), mDstStage(0), mBarrierCount(0), mBatchCount(0) {}
+
+VkImageAspectFlags ImageStateTracker::AspectMask(VkFormat format) {
+	switch (format) {
+	case VK_FORMAT_D16_UNORM:
+	case VK_FORMAT_X8_D24_UNORM_PACK32:
+	case VK_FORMAT_D32_SFLOAT:
+		return VK_IMAGE_ASPECT_DEPTH_BIT;
+	case VK_FORMAT_D16_UNORM_S8_UINT:
+	case VK_FORMAT_D24_UNORM_S8_UINT:
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+	default:
+		return VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+}
+
+void ImageStateTracker::Import(VkImage image, VkImageAspectFlags aspect, VkImageLayout layout, VkAccessFlags access, VkPipelineStageFlags stage) {
+	ImageState& state = mImages[image];
+	state.mAspect = aspect;
+	state.mLayout = layout;
+	state.mAccess = access;
+	state.mStage = stage;
+}
+
+void ImageStateTracker::Transition(VkImage image, VkImageLayout layout, VkAccessFlags access, VkPipelineStageFlags stage, bool discard) {
+	ImageState& state = mImages.at(image);
+
+	// Read after read in the same layout needs no barrier, but later writes have to wait on every reader
+	if (state.mLayout == layout && !(state.mAccess & gWriteAccess) && !(access & gWriteAccess)) {
+		state.mAccess |= access;
+		state.mStage |= stage;
+		return;
+	}
+
+	for (VkImageMemoryBarrier& b : mBarriers)
+		if (b.image == image) {
+			// Transitioned twice in one batch: the intermediate state is never observed, so retarget the queued barrier
+			b.newLayout = layout;
+			b.dstAccessMask |= access;
+			mDstStage |= stage;
+			state.mLayout = layout;
+			state.mAccess = access;
+			state.mStage = stage;
+			return;
+		}
+
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = state.mAccess & gWriteAccess; // only writes need to be made available
+	barrier.dstAccessMask = access;
+	barrier.oldLayout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.mLayout;
+	barrier.newLayout = layout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = state.mAspect;
+	barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+	barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+	mBarriers.push_back(barrier);
+
+	mSrcStage |= state.mStage;
+	mDstStage |= stage;
+
+	state.mLayout = layout;
+	state.mAccess = access;
+	state.mStage = stage;
+}
+
+void ImageStateTracker::Flush(VkCommandBuffer commandBuffer) {
+	if (mBarriers.empty()) return;
+
+	vkCmdPipelineBarrier(commandBuffer,
+		mSrcStage ? mSrcStage : (VkPipelineStageFlags)VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		mDstStage ? mDstStage : (VkPipelineStageFlags)VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		0,
+		0, nullptr,
+		0, nullptr,
+		(uint32_t)mBarriers.size(), mBarriers.data());
+
+	mBarrierCount += (uint32_t)mBarriers.size();
+	mBatchCount++;
+	mBarriers.clear();
+	mSrcStage = mDstStage = 0;
+}
\ No newline at end of file
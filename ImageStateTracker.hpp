@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <unordered_map>
+#include <vector>
+
+// Tracks the layout, access and stage of every image the plugin touches, so that each requested
+// transition only emits the barrier it actually needs, and all barriers queued between two Flush()
+// calls go out in a single vkCmdPipelineBarrier
+class ImageStateTracker {
+public:
+	ImageStateTracker();
+
+	static VkImageAspectFlags AspectMask(VkFormat format);
+
+	// Sets the current state of an image, e.g. after the engine has rendered into it
+	void Import(VkImage image, VkImageAspectFlags aspect, VkImageLayout layout, VkAccessFlags access, VkPipelineStageFlags stage);
+	// Requests that the image be in layout, ready for access at stage. With discard, the old contents are not preserved
+	void Transition(VkImage image, VkImageLayout layout, VkAccessFlags access, VkPipelineStageFlags stage, bool discard = false);
+	void Flush(VkCommandBuffer commandBuffer);
+
+	inline VkImageLayout Layout(VkImage image) { return mImages.at(image).mLayout; }
+	// Barriers queued for the next Flush()
+	inline const std::vector<VkImageMemoryBarrier>& PendingBarriers() const { return mBarriers; }
+
+	// Image barriers and vkCmdPipelineBarrier calls emitted since the last ResetCounters()
+	inline uint32_t BarrierCount() const { return mBarrierCount; }
+	inline uint32_t BatchCount() const { return mBatchCount; }
+	inline void ResetCounters() { mBarrierCount = mBatchCount = 0; }
+
+private:
+	struct ImageState {
+		VkImageAspectFlags mAspect;
+		VkImageLayout mLayout;
+		VkAccessFlags mAccess;
+		VkPipelineStageFlags mStage;
+	};
+
+	std::unordered_map<VkImage, ImageState> mImages;
+	std::vector<VkImageMemoryBarrier> mBarriers;
+	VkPipelineStageFlags mSrcStage;
+	VkPipelineStageFlags mDstStage;
+
+	uint32_t mBarrierCount;
+	uint32_t mBatchCount;
+};
\ No newline at end of file
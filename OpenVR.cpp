@@ -5,27 +5,93 @@
 #include <Scene/MeshRenderer.hpp>
 #include <assimp/pbrmaterial.h>
 
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+
 using namespace std;
 
 ENGINE_PLUGIN(OpenVR)
 
-OpenVR::OpenVR() : mScene(nullptr), mCamera(nullptr), mInput(nullptr){
+OpenVR::OpenVR() : mScene(nullptr), mCamera(nullptr), mVRDevice(nullptr), mInput(nullptr), mFrameNum(0), mWarmupFrames(2), mFirstSecondWorst(0), mFirstSecondFrames(0),
+	mSwapState(SCENE_SWAP_NONE), mSwapFadeTime(.25f), mSwapWorstFrame(0), mVRInitMs(0), mVRWaitMs(0), mPrefetchWaitMs(0), mPreRenderCalls(0), mPoseWrites(0),
+	mRequireHmdDevice(false), mPoseFrame(~0ull), mPipelined(false), mLeftEye(nullptr), mRightEye(nullptr), mLeftDepth(nullptr), mRightDepth(nullptr),
+	mMirrorMode(MIRROR_MODE_EYE), mMirror(nullptr), mMirrorRate(30.f), mMirrorVersion(0), mBackBufferExtent{}, mMirrorGpuTime{}, mMirrorFrames{}, mHud(nullptr), mCapture(nullptr),
+	mRenderScale(1.f), mBarrierCount(0), mBarrierBatchCount(0), mSyntheticLoad(0) {
 	mEnabled = true;
-	mVRDevice = new OpenVRDevice();
-	
+	mStartup = chrono::high_resolution_clock::now();
+	// The GPU check runs before anything could call RequireHmdDevice() on a plugin the engine loaded itself
+	mRequireHmdDevice = getenv("OPENVR_REQUIRE_HMD_GPU") != nullptr;
+
+	// Connecting to the runtime and reading the scene's files both run while the engine creates its instance and device
+	mVRDeviceInit = async(launch::async, [this]() {
+		auto t0 = chrono::high_resolution_clock::now();
+		OpenVRDevice* device = new OpenVRDevice();
+		mVRInitMs = chrono::duration<float, milli>(chrono::high_resolution_clock::now() - t0).count();
+		return device;
+	});
+	mSceneFolder = "Assets/Models/";
+	mSceneFile = "cornellbox.gltf";
+	mSwapPrefetch = async(launch::async, [this]() {
+		auto t0 = chrono::high_resolution_clock::now();
+		uint64_t bytes = PrefetchScene(mSceneFolder, mSceneFile);
+		mSwapPrefetchMs = chrono::duration<float, milli>(chrono::high_resolution_clock::now() - t0).count();
+		return bytes;
+	});
 }
 OpenVR::~OpenVR() {
+	if (mSwapPrefetch.valid()) mSwapPrefetch.wait();
+	if (!mVRDevice) {
+		// Startup failed before PreInstanceInit joined the runtime connection
+		try { mVRDevice = mVRDeviceInit.valid() ? mVRDeviceInit.get() : nullptr; } catch (...) {}
+		delete mVRDevice;
+		return;
+	}
+	PrintMirrorTimings();
+	if (mFrameNum)
+		printf("Poses: %.2f transform writes per frame, committed once across %.2f PreRender calls\n",
+			(float)mPoseWrites / mFrameNum, (float)mPreRenderCalls / mFrameNum);
+	if (mFrameNum)
+		printf("Barriers: %.2f image barriers in %.2f vkCmdPipelineBarrier calls per frame\n",
+			(float)mBarrierCount / mFrameNum, (float)mBarrierBatchCount / mFrameNum);
+	if (mMirrorMode == MIRROR_MODE_COMPOSITOR)
+		vr::VRCompositor()->HideMirrorWindow();
 	mScene->RemoveObject(mCamera);
 	mScene->RemoveObject(mCameraBase);
-	for (Object* obj : mObjects)
-		mScene->RemoveObject(obj);
+	UnloadScene();
 	delete mLeftEye;
 	delete mRightEye;
+	delete mLeftDepth;
+	delete mRightDepth;
+	delete mMirror;
+	delete mHud;
+	delete mCapture;
 	delete mVRDevice;
 }
 
+void OpenVR::JoinVRDevice() {
+	auto t0 = chrono::high_resolution_clock::now();
+	mVRDevice = mVRDeviceInit.get();
+	mVRDevice->Pipelined(mPipelined);
+	mVRWaitMs = chrono::duration<float, milli>(chrono::high_resolution_clock::now() - t0).count();
+}
+
+void OpenVR::PrintStartupTimeline() {
+	auto now = chrono::high_resolution_clock::now();
+	auto ms = [&](chrono::high_resolution_clock::time_point t) { return chrono::duration<float, milli>(t - mStartup).count(); };
+	// Everything the background tasks did that the main thread didn't wait for would have been serial before
+	float overlapped = (mVRInitMs - mVRWaitMs) + (mSwapPrefetchMs - mPrefetchWaitMs);
+	printf("Startup timeline (ms since plugin construction):\n");
+	printf("\tVR runtime connected  %.1f on a worker, main thread waited %.1f in PreInstanceInit\n", mVRInitMs, mVRWaitMs);
+	printf("\tScene files prefetched %.1f on a worker, main thread waited %.1f in Init\n", mSwapPrefetchMs, mPrefetchWaitMs);
+	printf("\tInit                  %.1f - %.1f (scene loaded at %.1f)\n", ms(mInitStart), ms(mInitEnd), ms(mSceneLoaded));
+	printf("\tFirst frame submitted %.1f, %.1f sooner than running the startup tasks serially\n", ms(now), overlapped);
+}
+
 void OpenVR::PreInstanceInit(Instance* instance)
 {
+	JoinVRDevice();
+
 	std::vector< std::string > requiredInstanceExtensions;
 	mVRDevice->GetVulkanInstanceExtensionsRequired(requiredInstanceExtensions);
 	for (std::string ex : requiredInstanceExtensions)
@@ -39,6 +105,22 @@ void OpenVR::PreInstanceInit(Instance* instance)
 
 void OpenVR::PreDeviceInit(Instance* instance, VkPhysicalDevice device)
 {
+	// The compositor reads the eye images on the GPU driving the headset, any other GPU costs a cross-adapter copy every frame
+	VkPhysicalDevice hmdDevice;
+	HmdDeviceCheck check = CheckHmdDevice(device, [&]() { return mVRDevice->GetOutputDevice(*instance); }, mRequireHmdDevice, hmdDevice);
+	if (check == HMD_DEVICE_MISMATCH || check == HMD_DEVICE_REFUSED) {
+		VkPhysicalDeviceProperties properties, hmdProperties;
+		vkGetPhysicalDeviceProperties(device, &properties);
+		vkGetPhysicalDeviceProperties(hmdDevice, &hmdProperties);
+		if (check == HMD_DEVICE_REFUSED) {
+			fprintf_color(COLOR_RED, stderr, "Error: Rendering on %s, but the HMD is driven by %s!\n", properties.deviceName, hmdProperties.deviceName);
+			throw "OPENVR_FAILURE";
+		}
+		fprintf_color(COLOR_YELLOW, stderr,
+			"Warning: Rendering on %s, but the HMD is driven by %s! Every frame will be copied across adapters.\n",
+			properties.deviceName, hmdProperties.deviceName);
+	}
+
 	std::vector< std::string > requiredDeviceExtensions;
 	mVRDevice->GetVulkanDeviceExtensionsRequired(device, requiredDeviceExtensions);
 	for (std::string ex : requiredDeviceExtensions)
@@ -50,25 +132,7 @@ void OpenVR::PreDeviceInit(Instance* instance, VkPhysicalDevice device)
 	//instance->RequestDeviceExtension(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
 }
 
-bool OpenVR::Init(Scene* scene) {
-
-	VkInstance i = *scene->Instance();
-	uint64_t device;
-	vr::VRSystem()->GetOutputDevice(&device, vr::TextureType_Vulkan, i);
-	printf("vrdevice: %d\n", device);
-
-	PFN_vkGetPhysicalDeviceProperties2KHR phys = (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr(*scene->Instance(), "vkGetPhysicalDeviceProperties2KHR");
-	printf("YAAS: %x\n", phys);
-
-
-
-	mScene = scene;
-	mInput = mScene->InputManager()->GetFirst<MouseKeyboardInput>();
-
-#pragma region load glTF
-	string folder = "Assets/Models/";
-	string file = "cornellbox.gltf";
-
+Object* OpenVR::LoadScene(const string& folder, const string& file) {
 	shared_ptr<Material> opaque = make_shared<Material>("PBR", mScene->AssetManager()->LoadShader("Shaders/pbr.stm"));
 	opaque->EnableKeyword("TEXTURED");
 	opaque->SetParameter("TextureST", float4(1, 1, 0, 0));
@@ -205,6 +269,7 @@ bool OpenVR::Init(Scene* scene) {
 	};
 
 	Object* root = mScene->LoadModelScene(folder + file, matfunc, objfunc, .6f, 1.f, .05f, .0015f);
+	if (!root) return nullptr;
 
 	root->LocalRotation(quaternion(float3(0, PI / 2, 0)));
 	queue<Object*> nodes;
@@ -217,13 +282,138 @@ bool OpenVR::Init(Scene* scene) {
 
 		mObjects.push_back(o);
 		if (Light* l = dynamic_cast<Light*>(o)) {
-			if (l->Type() == LIGHT_TYPE_SUN) {
-				l->CascadeCount(1);
-				l->ShadowDistance(30);
-			}
+			mLightIntensities.push_back(make_pair(l, l->Intensity()));
+			if (l->Type() == LIGHT_TYPE_SUN)
+				mSunLights.push_back(l);
 		}
 	}
-#pragma endregion
+
+	ApplyQuality(mGovernor.Level());
+	return root;
+}
+
+void OpenVR::UnloadScene() {
+	for (Object* obj : mObjects)
+		UntrackDevice(obj);
+	// mObjects is in breadth-first order from the model's root; removing the root takes its whole subtree out of the
+	// scene in one call, instead of one search of the scene's object list per node
+	if (mObjects.size())
+		mScene->RemoveObject(mObjects.front());
+	mObjects.clear();
+	mSunLights.clear();
+	mLightIntensities.clear();
+}
+
+void OpenVR::ApplyQuality(const QualityLevel& level) {
+	for (Light* light : mSunLights) {
+		light->ShadowDistance(level.mShadowDistance);
+		light->CascadeCount(level.mCascadeCount);
+	}
+	for (auto& light : mLightIntensities)
+		light.first->Intensity(level.mDirectLighting ? light.second : 0.f);
+}
+
+uint64_t OpenVR::PrefetchScene(const string& folder, const string& file) {
+	// Read the glTF and every file it references once, so the load at swap time hits the OS file cache instead of the disk
+	ifstream gltf(folder + file, ios::binary);
+	if (!gltf.is_open()) return 0;
+	string json((istreambuf_iterator<char>(gltf)), istreambuf_iterator<char>());
+	uint64_t bytes = json.size();
+
+	vector<char> buffer(1 << 20);
+	for (size_t p = json.find("\"uri\""); p != string::npos; p = json.find("\"uri\"", p + 5)) {
+		size_t start = json.find('"', json.find(':', p + 5));
+		size_t end = json.find('"', start + 1);
+		if (start == string::npos || end == string::npos) break;
+		string uri = json.substr(start + 1, end - start - 1);
+		if (uri.compare(0, 5, "data:") == 0) continue;
+
+		ifstream stream(folder + uri, ios::binary);
+		while (stream.read(buffer.data(), buffer.size()) || stream.gcount())
+			bytes += stream.gcount();
+	}
+	return bytes;
+}
+
+void OpenVR::SwapScene(const string& folder, const string& file) {
+	// Init still owns mSwapPrefetch for the startup scene
+	if (!mScene) {
+		fprintf_color(COLOR_YELLOW, stderr, "Warning: Scene swap to %s%s requested before Init, ignoring\n", folder.c_str(), file.c_str());
+		return;
+	}
+	if (mSwapState != SCENE_SWAP_NONE) {
+		fprintf_color(COLOR_YELLOW, stderr, "Warning: Scene swap to %s%s requested while another swap is in progress, ignoring\n", folder.c_str(), file.c_str());
+		return;
+	}
+	mSwapFolder = folder;
+	mSwapFile = file;
+	mSwapWorstFrame = 0;
+	mSwapRequest = chrono::high_resolution_clock::now();
+	mSwapPrefetch = async(launch::async, &OpenVR::PrefetchScene, folder, file);
+	mSwapState = SCENE_SWAP_PREFETCH;
+}
+
+void OpenVR::UpdateSceneSwap() {
+	auto now = chrono::high_resolution_clock::now();
+	switch (mSwapState) {
+	case SCENE_SWAP_PREFETCH: {
+		if (mSwapPrefetch.wait_for(chrono::seconds(0)) != future_status::ready) break;
+		mSwapBytes = mSwapPrefetch.get();
+		mSwapPrefetchMs = chrono::duration<float, milli>(now - mSwapRequest).count();
+		if (!mSwapBytes) {
+			fprintf_color(COLOR_RED, stderr, "Error: Failed to read %s%s, keeping the current scene\n", mSwapFolder.c_str(), mSwapFile.c_str());
+			mSwapState = SCENE_SWAP_NONE;
+			break;
+		}
+		vr::VRCompositor()->FadeToColor(mSwapFadeTime, 0, 0, 0, 1);
+		mSwapFade = now;
+		mSwapState = SCENE_SWAP_FADE_OUT;
+		break;
+	}
+	case SCENE_SWAP_FADE_OUT: {
+		if (chrono::duration<float>(now - mSwapFade).count() < mSwapFadeTime) break;
+		// No frames are submitted while the scene is decoded and uploaded on this thread. Suspended, the compositor stops
+		// waiting on them and keeps the HMD at full rate with its own frames, which the fade keeps black
+		vr::VRCompositor()->SuspendRendering(true);
+		UnloadScene();
+		auto unloaded = chrono::high_resolution_clock::now();
+		Object* root = LoadScene(mSwapFolder, mSwapFile);
+		auto loaded = chrono::high_resolution_clock::now();
+		vr::VRCompositor()->SuspendRendering(false);
+		if (root) {
+			mSceneFolder = mSwapFolder;
+			mSceneFile = mSwapFile;
+		} else
+			fprintf_color(COLOR_RED, stderr, "Error: Failed to load %s%s\n", mSwapFolder.c_str(), mSwapFile.c_str());
+		mSwapUnloadMs = chrono::duration<float, milli>(unloaded - now).count();
+		mSwapLoadMs = chrono::duration<float, milli>(loaded - unloaded).count();
+
+		vr::VRCompositor()->FadeToColor(mSwapFadeTime, 0, 0, 0, 0);
+		mSwapFade = loaded;
+		mSwapState = SCENE_SWAP_FADE_IN;
+		break;
+	}
+	case SCENE_SWAP_FADE_IN:
+		if (chrono::duration<float>(now - mSwapFade).count() < mSwapFadeTime) break;
+		printf("Scene swap to %s: %.2fMB prefetched in %.1fms, unload %.1fms, load %.1fms, worst frame %.2fms (budget %.2fms)\n",
+			mSwapFile.c_str(), mSwapBytes / (1024.f * 1024.f), mSwapPrefetchMs, mSwapUnloadMs, mSwapLoadMs, mSwapWorstFrame, mVRDevice->FrameDuration() * 1000.f);
+		mSwapState = SCENE_SWAP_NONE;
+		break;
+	case SCENE_SWAP_NONE:
+		break;
+	}
+}
+
+bool OpenVR::Init(Scene* scene) {
+
+	mInitStart = chrono::high_resolution_clock::now();
+	mScene = scene;
+	mInput = mScene->InputManager()->GetFirst<MouseKeyboardInput>();
+
+	mSwapBytes = mSwapPrefetch.get();
+	mPrefetchWaitMs = chrono::duration<float, milli>(chrono::high_resolution_clock::now() - mInitStart).count();
+	if (!LoadScene(mSceneFolder, mSceneFile)) return false;
+	mSceneLoaded = chrono::high_resolution_clock::now();
 
 	mScene->Environment()->EnableCelestials(false);
 	mScene->Environment()->EnableScattering(false);
@@ -245,10 +435,11 @@ bool OpenVR::Init(Scene* scene) {
 
 	//vector<VkFormat> colorFormats{ VK_FORMAT_R8G8B8A8_UNORM };
 	//Framebuffer* f = new Framebuffer("Openvr Camera", scene->Instance()->Device(), renderWidth, renderHeight, colorFormats, VK_FORMAT_D32_SFLOAT, VK_SAMPLE_COUNT_1_BIT, {}, VK_ATTACHMENT_LOAD_OP_CLEAR);
-	shared_ptr<Camera> camera = make_shared<Camera>("Camera", scene->Instance()->Window());
+	// The camera renders offscreen; the desktop only ever sees the (optional) mirror, see RecordMirror
+	shared_ptr<Camera> camera = make_shared<Camera>("Camera", scene->Instance()->Device());
 	mScene->AddObject(camera);
-	camera->Near(.01f);
-	camera->Far(1024.f);
+	camera->Near(mVRDevice->NearClip());
+	camera->Far(mVRDevice->FarClip());
 	camera->FieldOfView(radians(65.f));
 	camera->LocalPosition(0, 0, 0);
 	camera->FramebufferWidth(renderWidth);
@@ -290,10 +481,61 @@ bool OpenVR::Init(Scene* scene) {
 		VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL,
 		flags);
 
+	mMirror = new Texture("Mirror Texture",
+		scene->Instance()->Device(),
+		mLeftEye->Width() / 2, mLeftEye->Height() / 2, 1,
+		VK_FORMAT_R8G8B8A8_SRGB,
+		VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+	if (mMirrorMode == MIRROR_MODE_COMPOSITOR)
+		vr::VRCompositor()->ShowMirrorWindow();
+
+	mHud = new PerformanceHud(scene->Instance()->Device(), mTracker);
+	// Both eyes side by side, at a quarter of their resolution
+	mCapture = new SessionCapture(scene->Instance()->Device(), mTracker, mLeftEye->Width(), mLeftEye->Height() / 2);
+	mRenderScale = (float)mCamera->FramebufferWidth() / renderWidth;
+
+	// Hide the first frames behind the compositor grid. The engine builds each pipeline on its first draw, which for most of
+	// the scene is one of these frames; a pipeline first drawn later can still hitch
+	if (mWarmupFrames)
+		vr::VRCompositor()->FadeGrid(0.f, true);
+
+	mTracker.Import(mLeftEye->Image(), VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+	mTracker.Import(mRightEye->Image(), VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+	mTracker.Import(mMirror->Image(), VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
+	// Depth can only be copied out per eye when the camera renders it single-sampled (depth is not resolvable)
+	Texture* depthBuffer = mCamera->Framebuffer()->DepthBuffer();
+	if (depthBuffer && depthBuffer->SampleCount() == VK_SAMPLE_COUNT_1_BIT) {
+		mLeftDepth = new Texture("Left Eye Depth",
+			scene->Instance()->Device(),
+			mLeftEye->Width(), mLeftEye->Height(), 1,
+			depthBuffer->Format(),
+			VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL,
+			flags);
+		mRightDepth = new Texture("Right Eye Depth",
+			scene->Instance()->Device(),
+			mRightEye->Width(), mRightEye->Height(), 1,
+			depthBuffer->Format(),
+			VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL,
+			flags);
+		VkImageAspectFlags aspect = ImageStateTracker::AspectMask(depthBuffer->Format());
+		mTracker.Import(mLeftDepth->Image(), aspect, VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+		mTracker.Import(mRightDepth->Image(), aspect, VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+	} else
+		fprintf_color(COLOR_YELLOW, stderr, "Camera depth buffer is multisampled, submitting eyes without depth\n");
+
+	mInitEnd = chrono::high_resolution_clock::now();
 	return true;
 }
 
 void OpenVR::Update() {
+	mUpdateStart = chrono::high_resolution_clock::now();
+#ifdef _DEBUG
+	// Busy-waits to push the frame over budget on demand, for exercising the quality governor
+	while (mSyntheticLoad > 0 && chrono::duration<float, milli>(chrono::high_resolution_clock::now() - mUpdateStart).count() < mSyntheticLoad);
+#endif
+
 	mVRDevice->CalculateEyeAdjustment();
 	//mCamera->EyeTransform(mVRDevice->LeftEyeMatrix(), EYE_LEFT);
 	//mCamera->EyeTransform(mVRDevice->RightEyeMatrix(), EYE_RIGHT);
@@ -305,17 +547,82 @@ void OpenVR::Update() {
 
 	if (mInput->KeyDownFirst(KEY_F1))
 		mScene->DrawGizmos(!mScene->DrawGizmos());
-	//if (mInput->KeyDownFirst(KEY_TILDE))
-	//	mShowPerformance = !mShowPerformance;
+	if (mInput->KeyDownFirst(KEY_F2))
+		MirrorMode((::MirrorMode)((mMirrorMode + 1) % MIRROR_MODE_COUNT));
+	if (mInput->KeyDownFirst(KEY_TILDE)) {
+		if (mHud->Visible()) mHud->Hide();
+		else mHud->Show();
+	}
+	if (mInput->KeyDownFirst(KEY_F5))
+		SwapScene(mSceneFolder, mSceneFile);
+	if (mInput->KeyDownFirst(KEY_F3)) {
+		mGovernor.Enabled(!mGovernor.Enabled());
+		printf("Quality governor %s\n", mGovernor.Enabled() ? "enabled" : "disabled");
+	}
+#ifdef _DEBUG
+	if (mInput->KeyDownFirst(KEY_F8)) {
+		SyntheticLoad(max(mSyntheticLoad - 2.f, 0.f));
+		printf("Synthetic load: %.1fms\n", mSyntheticLoad);
+	}
+	if (mInput->KeyDownFirst(KEY_F9)) {
+		SyntheticLoad(mSyntheticLoad + 2.f);
+		printf("Synthetic load: %.1fms\n", mSyntheticLoad);
+	}
+#endif
+	if (mInput->KeyDownFirst(KEY_F6)) {
+		if (mCapture->Capturing()) mCapture->Stop();
+		else mCapture->Start("capture_" + to_string(time(nullptr)) + ".vrcap");
+	}
+
+	UpdateSceneSwap();
 
 	mVRDevice->Update();
 }
 
+void OpenVR::CommitPose(Object* object, const float3& position, const quaternion& rotation) {
+	// Setting a transform dirties the object's whole subtree, so leave objects that didn't move alone
+	if (object->LocalPosition() != position) {
+		object->LocalPosition(position);
+		mPoseWrites++;
+	}
+	if (object->LocalRotation() != rotation) {
+		object->LocalRotation(rotation);
+		mPoseWrites++;
+	}
+}
+
+void OpenVR::CommitPoses() {
+	CommitPose(mCamera, mVRDevice->Position(), mVRDevice->Rotation());
+	for (TrackedObject& tracked : mTrackedObjects) {
+		float3 position;
+		quaternion rotation;
+		if (mVRDevice->DevicePose(tracked.mDevice, position, rotation))
+			CommitPose(tracked.mObject, position, rotation);
+	}
+}
+
+void OpenVR::TrackDevice(vr::TrackedDeviceIndex_t device, Object* object) {
+	UntrackDevice(object);
+	TrackedObject tracked = {};
+	tracked.mDevice = device;
+	tracked.mObject = object;
+	mTrackedObjects.push_back(tracked);
+}
+
+void OpenVR::UntrackDevice(Object* object) {
+	for (auto it = mTrackedObjects.begin(); it != mTrackedObjects.end();)
+		if (it->mObject == object) it = mTrackedObjects.erase(it);
+		else it++;
+}
+
 void OpenVR::PreRender(CommandBuffer* commandBuffer, Camera* camera, PassType pass)
 {
-
-	camera->LocalPosition(mVRDevice->Position());
-	camera->LocalRotation(mVRDevice->Rotation());
+	mPreRenderCalls++;
+	// Poses are committed once, before the first pass of the frame; every later pass draws from the same snapshot
+	if (camera == mCamera && mPoseFrame != mFrameNum) {
+		mPoseFrame = mFrameNum;
+		CommitPoses();
+	}
 }
 
 /*
@@ -332,24 +639,29 @@ void OpenVR::PostProcess(CommandBuffer* commandBuffer, Camera* camera) {
 		return;
 	}
 
-	//mCamera->Resolve(commandBuffer);
-	VkPipelineStageFlags srcStage, dstStage, srcStage2, dstStage2;
-	//mCamera->ResolveBuffer()->TransitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, commandBuffer);
-	VkImageMemoryBarrier barrier[3] = {};
-	barrier[0] = mCamera->ResolveBuffer()->TransitionImageLayout(VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, srcStage, dstStage);
-	barrier[1] = mLeftEye->TransitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, srcStage2, dstStage2);
-	barrier[2] = mRightEye->TransitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, srcStage2, dstStage2);
-
-	srcStage = srcStage | srcStage2;
-	dstStage = dstStage | dstStage2;
-	vkCmdPipelineBarrier(*commandBuffer,
-		srcStage, dstStage,
-		0,
-		0, nullptr,
-		0, nullptr,
-		3, barrier);
-
+	// The eyes are copied out of the halves of the camera's resolve buffer
+	Texture* source = mCamera->ResolveBuffer();
+	Texture* depthBuffer = mLeftDepth ? mCamera->Framebuffer()->DepthBuffer() : nullptr;
+
+	// The camera's targets come straight from the engine's render pass. The resolve buffer stays in GENERAL, where the
+	// engine's resolve and post-processing may have written it with transfers or compute shaders, and may again next frame
+	VkAccessFlags sourceAccess = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	VkPipelineStageFlags sourceStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	mTracker.Import(source->Image(), VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_GENERAL, sourceAccess, sourceStage);
+	mTracker.Transition(source->Image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	mTracker.Transition(mLeftEye->Image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, true);
+	mTracker.Transition(mRightEye->Image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, true);
+	if (depthBuffer) {
+		mTracker.Import(depthBuffer->Image(), ImageStateTracker::AspectMask(depthBuffer->Format()), VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT);
+		mTracker.Transition(depthBuffer->Image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		mTracker.Transition(mLeftDepth->Image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, true);
+		mTracker.Transition(mRightDepth->Image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, true);
+	}
+	mHud->Update();
+	mTracker.Flush(*commandBuffer);
 
+	mHud->Record(commandBuffer);
 
 	VkImageSubresourceLayers srcLayers = {};
 	srcLayers.baseArrayLayer = 0;
@@ -381,88 +693,248 @@ void OpenVR::PostProcess(CommandBuffer* commandBuffer, Camera* camera) {
 	copy2.extent = extent;
 	copy2.srcOffset = rightOffset;
 
-	//copy.
-	vkCmdCopyImage(*commandBuffer, mCamera->ResolveBuffer()->Image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mLeftEye->Image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
-	vkCmdCopyImage(*commandBuffer, mCamera->ResolveBuffer()->Image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mRightEye->Image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy2);
+	vkCmdCopyImage(*commandBuffer, source->Image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mLeftEye->Image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+	vkCmdCopyImage(*commandBuffer, source->Image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mRightEye->Image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy2);
+
+	if (depthBuffer) {
+		copy.srcSubresource.aspectMask = copy.dstSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		copy2.srcSubresource.aspectMask = copy2.dstSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		vkCmdCopyImage(*commandBuffer, depthBuffer->Image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mLeftDepth->Image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+		vkCmdCopyImage(*commandBuffer, depthBuffer->Image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mRightDepth->Image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy2);
+	}
+
+	// Hand the camera's targets back for the next render pass and leave the eyes ready to submit
+	sourceAccess |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+	mTracker.Transition(source->Image(), VK_IMAGE_LAYOUT_GENERAL, sourceAccess, sourceStage);
+	mTracker.Transition(mLeftEye->Image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	mTracker.Transition(mRightEye->Image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	if (depthBuffer) {
+		mTracker.Transition(depthBuffer->Image(), VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT);
+		mTracker.Transition(mLeftDepth->Image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		mTracker.Transition(mRightDepth->Image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	}
+
+	// The mirror's first transitions ride along in the same batch. The engine presents the back buffer whatever the
+	// mirror mode, so it is never handed over undefined: each swapchain image is written (or cleared) once, and then
+	// only again when what it should show changes. Swapchain images keep their contents across presents, and nothing
+	// else writes them.
+	VkImage backBuffer = mScene->Instance()->Window()->BackBuffer();
+	bool refreshMirror = false;
+	bool writeBackBuffer = false;
+	if (backBuffer != VK_NULL_HANDLE) {
+		// Only re-sample the eye at the mirror rate, the mirror texture is re-presented in between
+		auto now = chrono::high_resolution_clock::now();
+		if (mMirrorMode == MIRROR_MODE_EYE && chrono::duration<float>(now - mLastMirror).count() >= 1.f / mMirrorRate) {
+			mLastMirror = now;
+			mMirrorVersion++;
+			refreshMirror = true;
+			mTracker.Transition(mMirror->Image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, true);
+		}
+
+		VkExtent2D windowExtent = mScene->Instance()->Window()->ClientRect().extent;
+		if (windowExtent.width != mBackBufferExtent.width || windowExtent.height != mBackBufferExtent.height) {
+			mBackBufferContents.clear();
+			mBackBufferExtent = windowExtent;
+		}
+		uint64_t contents = mMirrorMode == MIRROR_MODE_EYE ? mMirrorVersion : 0;
+		auto it = mBackBufferContents.find(backBuffer);
+		if (it == mBackBufferContents.end() || it->second != contents) {
+			mBackBufferContents[backBuffer] = contents;
+			writeBackBuffer = true;
+			// The whole image is overwritten. The frame waits on the engine's acquire semaphore at color attachment output,
+			// so the barrier has to start from that stage to be ordered after the acquire
+			mTracker.Import(backBuffer, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+			mTracker.Transition(backBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, true);
+		}
+	}
+	bool capture = mCapture->Prepare();
+	mTracker.Flush(*commandBuffer);
+
+	if (writeBackBuffer)
+		RecordMirror(commandBuffer, backBuffer, refreshMirror);
+	if (capture)
+		mCapture->Record(commandBuffer, mLeftEye, mRightEye, mFrameNum, mVRDevice->RenderPose());
+
+	// Pipelined, everything above was recorded while the previous frame was still on the GPU. Only now block until the
+	// compositor wants this frame, then hand over the timing data: the end of PostProcess is the last point the plugin
+	// gets before the engine submits the command buffer
+	mVRDevice->WaitPoses();
+	mVRDevice->SubmitTimingData();
+}
 
+void OpenVR::RecordMirror(CommandBuffer* commandBuffer, VkImage backBuffer, bool refresh) {
+	if (mMirrorMode != MIRROR_MODE_EYE) {
+		VkClearColorValue black = {};
+		VkImageSubresourceRange range = {};
+		range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		range.levelCount = 1;
+		range.layerCount = 1;
+		vkCmdClearColorImage(*commandBuffer, backBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &black, 1, &range);
+		mTracker.Transition(backBuffer, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, 0, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		mTracker.Flush(*commandBuffer);
+		return;
+	}
 
+	VkExtent2D windowExtent = mScene->Instance()->Window()->ClientRect().extent;
 
+	VkImageSubresourceLayers layers = {};
+	layers.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	layers.layerCount = 1;
 
-	VkImageMemoryBarrier barrier2[3] = {};
-	barrier2[0] = mCamera->ResolveBuffer()->TransitionImageLayout(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL, srcStage, dstStage);
-	barrier2[1] = mLeftEye->TransitionImageLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, srcStage2, dstStage2);
-	barrier2[2] = mLeftEye->TransitionImageLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, srcStage2, dstStage2);
+	if (refresh) {
+		VkImageBlit blit = {};
+		blit.srcSubresource = layers;
+		blit.srcOffsets[1] = { (int32_t)mLeftEye->Width(), (int32_t)mLeftEye->Height(), 1 };
+		blit.dstSubresource = layers;
+		blit.dstOffsets[1] = { (int32_t)mMirror->Width(), (int32_t)mMirror->Height(), 1 };
+		vkCmdBlitImage(*commandBuffer, mLeftEye->Image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mMirror->Image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+		mTracker.Transition(mMirror->Image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		mTracker.Flush(*commandBuffer);
+	}
 
-	srcStage = srcStage | srcStage2;
-	dstStage = dstStage | dstStage2;
-	vkCmdPipelineBarrier(*commandBuffer,
-		srcStage, dstStage,
-		0,
-		0, nullptr,
-		0, nullptr,
-		3, barrier2);
-		
+	VkImageBlit blit = {};
+	blit.srcSubresource = layers;
+	blit.srcOffsets[1] = { (int32_t)mMirror->Width(), (int32_t)mMirror->Height(), 1 };
+	blit.dstSubresource = layers;
+	blit.dstOffsets[1] = { (int32_t)windowExtent.width, (int32_t)windowExtent.height, 1 };
+	vkCmdBlitImage(*commandBuffer, mMirror->Image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, backBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+	mTracker.Transition(backBuffer, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, 0, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+	mTracker.Flush(*commandBuffer);
 }
 
-void OpenVR::PreSwap()
-{
-	/*
-	// Submit to SteamVR
-	vr::VRTextureBounds_t leftBounds;
-	leftBounds.uMin = 0.0f;
-	leftBounds.uMax = 1.0f;
-	leftBounds.vMin = 0.5f;
-	leftBounds.vMax = 1.0f;
-
-	vr::VRTextureBounds_t rightBounds;
-	rightBounds.uMin = 0.0f;
-	rightBounds.uMax = 1.0f;
-	rightBounds.vMin = 0.5f;
-	rightBounds.vMax = 1.0f;
-	*/
-	//tex->TransitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, commandBuffer);
-
-	vr::VRVulkanTextureData_t vulkanDataLeft;
-	vulkanDataLeft.m_nImage = (uint64_t)(mLeftEye->Image());
-	vulkanDataLeft.m_pDevice = *mScene->Instance()->Device();
-	vulkanDataLeft.m_pPhysicalDevice = mScene->Instance()->Device()->PhysicalDevice();
-	vulkanDataLeft.m_pInstance = *mScene->Instance()->Device()->Instance();
-	vulkanDataLeft.m_pQueue = mScene->Instance()->Device()->GraphicsQueue();
-	vulkanDataLeft.m_nQueueFamilyIndex = mScene->Instance()->Device()->GraphicsQueueFamily();
-
-	vulkanDataLeft.m_nHeight = mLeftEye->Height();
-	vulkanDataLeft.m_nWidth = mLeftEye->Width();
-	vulkanDataLeft.m_nFormat = mLeftEye->Format();
-	vulkanDataLeft.m_nSampleCount = mLeftEye->SampleCount();
-
-	vr::Texture_t textureLeft = { &vulkanDataLeft, vr::TextureType_Vulkan, vr::ColorSpace_Gamma };
-
-	vr::VRVulkanTextureData_t vulkanDataRight;
-	vulkanDataRight.m_nImage = (uint64_t)(mRightEye->Image());
-	vulkanDataRight.m_pDevice = *mScene->Instance()->Device();
-	vulkanDataRight.m_pPhysicalDevice = mScene->Instance()->Device()->PhysicalDevice();
-	vulkanDataRight.m_pInstance = *mScene->Instance()->Device()->Instance();
-	vulkanDataRight.m_pQueue = mScene->Instance()->Device()->GraphicsQueue();
-	vulkanDataRight.m_nQueueFamilyIndex = mScene->Instance()->Device()->GraphicsQueueFamily();
-
-	vulkanDataRight.m_nHeight = mRightEye->Height();
-	vulkanDataRight.m_nWidth = mRightEye->Width();
-	vulkanDataRight.m_nFormat = mRightEye->Format();
-	vulkanDataRight.m_nSampleCount = mRightEye->SampleCount();
-
-	vr::Texture_t textureRight = { &vulkanDataRight, vr::TextureType_Vulkan, vr::ColorSpace_Gamma };
-
-
-
-	vr::EVRCompositorError error;
-	error = vr::VRCompositor()->Submit(vr::Eye_Left, &textureLeft, nullptr);
-	if (error != vr::VRCompositorError_None)
-	{
-		printf_color(COLOR_RED, "Compositor error on left eye submission: %d\n", error);
+#ifdef _DEBUG
+void OpenVR::SyntheticLoad(float ms) {
+	mSyntheticLoad = ms;
+}
+#endif
+
+void OpenVR::Pipelined(bool pipelined) {
+	// The compositor's timing mode is set once, when the runtime connection is joined
+	if (mVRDevice) {
+		fprintf_color(COLOR_YELLOW, stderr, "Warning: The frame mode can only be chosen before PreInstanceInit, staying %s\n", mPipelined ? "pipelined" : "serial");
+		return;
+	}
+	mPipelined = pipelined;
+}
+
+void OpenVR::MirrorMode(::MirrorMode mode) {
+	if (mode == mMirrorMode) return;
+	PrintMirrorTimings();
+
+	if (mMirrorMode == MIRROR_MODE_COMPOSITOR)
+		vr::VRCompositor()->HideMirrorWindow();
+	if (mode == MIRROR_MODE_COMPOSITOR)
+		vr::VRCompositor()->ShowMirrorWindow();
+	mMirrorMode = mode;
+}
+
+void OpenVR::PrintMirrorTimings() {
+	const char* names[MIRROR_MODE_COUNT] = { "none", "eye", "compositor" };
+	float eyeTime = mMirrorFrames[MIRROR_MODE_EYE] ? (float)(mMirrorGpuTime[MIRROR_MODE_EYE] / mMirrorFrames[MIRROR_MODE_EYE]) : 0.f;
+	for (uint32_t i = 0; i < MIRROR_MODE_COUNT; i++) {
+		if (!mMirrorFrames[i]) continue;
+		float avg = (float)(mMirrorGpuTime[i] / mMirrorFrames[i]);
+		printf("Mirror mode %s: %.3fms GPU over %u frames", names[i], avg, mMirrorFrames[i]);
+		if (i != MIRROR_MODE_EYE && eyeTime > 0.f) printf(" (%.3fms saved vs eye)", eyeTime - avg);
+		printf("\n");
+	}
+}
+
+void OpenVR::SubmitEye(vr::EVREye eye, Texture* color, Texture* depth, const vr::HmdMatrix44_t& projection) {
+	Device* device = mScene->Instance()->Device();
+
+	vr::VRVulkanTextureData_t vulkanData[2];
+	Texture* textures[2] = { color, depth };
+	for (uint32_t i = 0; i < 2; i++) {
+		if (!textures[i]) continue;
+		vulkanData[i].m_nImage = (uint64_t)(textures[i]->Image());
+		vulkanData[i].m_pDevice = *device;
+		vulkanData[i].m_pPhysicalDevice = device->PhysicalDevice();
+		vulkanData[i].m_pInstance = *device->Instance();
+		vulkanData[i].m_pQueue = device->GraphicsQueue();
+		vulkanData[i].m_nQueueFamilyIndex = device->GraphicsQueueFamily();
+
+		vulkanData[i].m_nHeight = textures[i]->Height();
+		vulkanData[i].m_nWidth = textures[i]->Width();
+		vulkanData[i].m_nFormat = textures[i]->Format();
+		vulkanData[i].m_nSampleCount = textures[i]->SampleCount();
 	}
-	vr::VRCompositor()->Submit(vr::Eye_Right, &textureRight, nullptr);
+
+	// The camera renders with the same projection, so the depth range follows from it and the device's clip planes
+	vr::VRTextureWithPoseAndDepth_t texture;
+	vr::EVRSubmitFlags flags = EyeTexture(texture, &vulkanData[0], depth ? &vulkanData[1] : nullptr,
+		mVRDevice->RenderPose(), projection, mVRDevice->NearClip(), mVRDevice->FarClip());
+
+	vr::EVRCompositorError error = vr::VRCompositor()->Submit(eye, &texture, nullptr, flags);
 	if (error != vr::VRCompositorError_None)
-	{
-		//printf_color(COLOR_RED, "Compositor error on right eye submission: %d\n", error);
+		printf_color(COLOR_RED, "Compositor error on %s eye submission: %d\n", eye == vr::Eye_Left ? "left" : "right", error);
+}
+
+void OpenVR::PreSwap() {
+	SubmitEye(vr::Eye_Left, mLeftEye, mLeftDepth, mVRDevice->LeftProjectionRaw());
+	SubmitEye(vr::Eye_Right, mRightEye, mRightDepth, mVRDevice->RightProjectionRaw());
+	mHud->Submit();
+	mVRDevice->PostPresent();
+	if (mFrameNum == 0) PrintStartupTimeline();
+	mFrameNum++;
+
+	vr::Compositor_FrameTiming timing;
+	bool timed = mVRDevice->GetFrameTiming(timing);
+	if (timed) {
+		mMirrorGpuTime[mMirrorMode] += timing.m_flTotalRenderGpuMs;
+		mMirrorFrames[mMirrorMode]++;
+	}
+
+	if (mFrameNum == mWarmupFrames)
+		vr::VRCompositor()->FadeGrid(.5f, false);
+
+	// Track the worst frame of the first second after warm-up, where first-draw hitches show up
+	if (mFrameNum == mWarmupFrames + 1)
+		mFirstFrame = chrono::high_resolution_clock::now();
+	else if (mFrameNum > mWarmupFrames + 1 && mFirstSecondFrames != ~0u) {
+		if (timed) {
+			if (timing.m_flClientFrameIntervalMs > mFirstSecondWorst) mFirstSecondWorst = timing.m_flClientFrameIntervalMs;
+			mFirstSecondFrames++;
+		}
+		if (chrono::duration<float>(chrono::high_resolution_clock::now() - mFirstFrame).count() >= 1.f) {
+			printf("First second: %u frames, worst frame %.2fms (budget %.2fms)\n",
+				mFirstSecondFrames, mFirstSecondWorst, mVRDevice->FrameDuration() * 1000.f);
+			mFirstSecondFrames = ~0u;
+		}
+	}
+
+	if (mSwapState != SCENE_SWAP_NONE && timed && timing.m_flClientFrameIntervalMs > mSwapWorstFrame)
+		mSwapWorstFrame = timing.m_flClientFrameIntervalMs;
+
+	// CPU time is this frame's work without the pose wait, serial or pipelined; GPU time is the application's share, before
+	// and after submit. Warm-up and scene swaps are slow on purpose and would only push the level down
+	if (timed && mFrameNum > mWarmupFrames && mSwapState == SCENE_SWAP_NONE) {
+		float frame = chrono::duration<float, milli>(chrono::high_resolution_clock::now() - mUpdateStart).count();
+		float gpu = timing.m_flPreSubmitGpuMs + timing.m_flPostSubmitGpuMs;
+		if (mGovernor.Update(frame, mVRDevice->PoseWaitMs(), gpu, mVRDevice->FrameDuration() * 1000.f))
+			ApplyQuality(mGovernor.Level());
+	}
+
+	mBarrierCount += mTracker.BarrierCount();
+	mBarrierBatchCount += mTracker.BatchCount();
+	mTracker.ResetCounters();
+
+	if (mHud->Visible() && timed) {
+		vr::Compositor_CumulativeStats cumulative = {};
+		vr::VRCompositor()->GetCumulativeStats(&cumulative, sizeof(vr::Compositor_CumulativeStats));
+
+		PerformanceStats stats = {};
+		stats.mFrameTime = timing.m_flClientFrameIntervalMs;
+		stats.mGpuTime = timing.m_flTotalRenderGpuMs;
+		stats.mBudget = mVRDevice->FrameDuration() * 1000.f;
+		stats.mMissedFrames = cumulative.m_nNumDroppedFrames;
+		stats.mReprojectedFrames = cumulative.m_nNumReprojectedFrames;
+		stats.mRenderScale = mRenderScale;
+		stats.mPipelined = mPipelined;
+		stats.mPoseLatency = mVRDevice->PoseLatency();
+		mHud->Stats(stats);
 	}
 }
\ No newline at end of file
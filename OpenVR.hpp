@@ -6,6 +6,30 @@
 #include <Util/Profiler.hpp>
 
 #include "OpenVRDevice.hpp"
+#include "EyeTexture.hpp"
+#include "HmdDevice.hpp"
+#include "ImageStateTracker.hpp"
+#include "PerformanceHud.hpp"
+#include "SessionCapture.hpp"
+#include "QualityGovernor.hpp"
+
+#include <chrono>
+#include <future>
+#include <unordered_map>
+
+enum MirrorMode {
+	MIRROR_MODE_NONE,		// The desktop window is cleared to black
+	MIRROR_MODE_EYE,		// The left eye, downsampled and rate-limited
+	MIRROR_MODE_COMPOSITOR,	// SteamVR's own mirror window, the desktop window is cleared to black
+	MIRROR_MODE_COUNT
+};
+
+enum SceneSwapState {
+	SCENE_SWAP_NONE,
+	SCENE_SWAP_PREFETCH,	// Reading the new scene's files on a worker thread
+	SCENE_SWAP_FADE_OUT,	// Fading the compositor to black, the old scene is still drawn
+	SCENE_SWAP_FADE_IN,		// The new scene is loaded, fading back in
+};
 
 class OpenVR : public EnginePlugin {
 private:
@@ -16,9 +40,110 @@ private:
 	MouseKeyboardInput* mInput;
 	std::vector<Object*> mObjects;
 	uint64_t mFrameNum;
+	// Imported sun lights, whose shadow distance and cascades follow the quality level
+	std::vector<Light*> mSunLights;
+	// Every imported light with its authored intensity, for ApplyQuality
+	std::vector<std::pair<Light*, float>> mLightIntensities;
+
+	// Frames rendered behind the compositor grid at startup, while the engine builds pipelines on first draw
+	uint32_t mWarmupFrames;
+	std::chrono::high_resolution_clock::time_point mFirstFrame;
+	float mFirstSecondWorst;
+	uint32_t mFirstSecondFrames;
+
+	std::string mSceneFolder;
+	std::string mSceneFile;
+
+	SceneSwapState mSwapState;
+	std::string mSwapFolder;
+	std::string mSwapFile;
+	std::future<uint64_t> mSwapPrefetch;
+	float mSwapFadeTime;
+	std::chrono::high_resolution_clock::time_point mSwapRequest;
+	std::chrono::high_resolution_clock::time_point mSwapFade;
+	uint64_t mSwapBytes;
+	float mSwapPrefetchMs;
+	float mSwapUnloadMs;
+	float mSwapLoadMs;
+	float mSwapWorstFrame;
+
+	Object* LoadScene(const std::string& folder, const std::string& file);
+	void UnloadScene();
+	static uint64_t PrefetchScene(const std::string& folder, const std::string& file);
+	void UpdateSceneSwap();
+
+	// Startup tasks run concurrently with the engine's own initialization, see PrintStartupTimeline
+	std::future<OpenVRDevice*> mVRDeviceInit;
+	std::chrono::high_resolution_clock::time_point mStartup;
+	std::chrono::high_resolution_clock::time_point mInitStart;
+	std::chrono::high_resolution_clock::time_point mSceneLoaded;
+	std::chrono::high_resolution_clock::time_point mInitEnd;
+	float mVRInitMs;
+	float mVRWaitMs;
+	float mPrefetchWaitMs;
+
+	void JoinVRDevice();
+	void PrintStartupTimeline();
+
+	// Scene objects driven by a tracked device's pose, written along with the camera once per frame
+	struct TrackedObject {
+		vr::TrackedDeviceIndex_t mDevice;
+		Object* mObject;
+	};
+	std::vector<TrackedObject> mTrackedObjects;
+	uint64_t mPreRenderCalls;
+	uint64_t mPoseWrites;
+
+	void CommitPose(Object* object, const float3& position, const quaternion& rotation);
+	void CommitPoses();
+
+	// Refuse to start, rather than warn, when the engine picked a different GPU than the one driving the HMD.
+	// Set by OPENVR_REQUIRE_HMD_GPU or RequireHmdDevice()
+	bool mRequireHmdDevice;
+	uint64_t mPoseFrame;
+	// Applied to mVRDevice once, when it is joined, see OpenVRDevice::Pipelined
+	bool mPipelined;
 
 	Texture* mLeftEye;
 	Texture* mRightEye;
+	// Per-eye copies of the camera's depth buffer, submitted for depth-aware reprojection
+	Texture* mLeftDepth;
+	Texture* mRightDepth;
+
+	::MirrorMode mMirrorMode;
+	Texture* mMirror;
+	float mMirrorRate;
+	std::chrono::high_resolution_clock::time_point mLastMirror;
+	// Bumped every time mMirror is re-sampled from the eye
+	uint64_t mMirrorVersion;
+	// What each swapchain image was last left holding, mMirrorVersion or 0 for black, so an unchanged image is not
+	// written again. Cleared when the window size changes, since the engine recreates the swapchain then
+	std::unordered_map<VkImage, uint64_t> mBackBufferContents;
+	VkExtent2D mBackBufferExtent;
+	// Compositor-reported GPU time, accumulated per mirror mode
+	double mMirrorGpuTime[MIRROR_MODE_COUNT];
+	uint32_t mMirrorFrames[MIRROR_MODE_COUNT];
+
+	PerformanceHud* mHud;
+	SessionCapture* mCapture;
+	// Eye framebuffer size relative to the runtime's recommended size
+	float mRenderScale;
+
+	// Layouts of everything PostProcess touches, carried across frames
+	ImageStateTracker mTracker;
+	uint64_t mBarrierCount;
+	uint64_t mBarrierBatchCount;
+
+	QualityGovernor mGovernor;
+	std::chrono::high_resolution_clock::time_point mUpdateStart;
+	// Debug builds only, see SyntheticLoad()
+	float mSyntheticLoad;
+
+	void ApplyQuality(const QualityLevel& level);
+
+	void RecordMirror(CommandBuffer* commandBuffer, VkImage backBuffer, bool refresh);
+	void PrintMirrorTimings();
+	void SubmitEye(vr::EVREye eye, Texture* color, Texture* depth, const vr::HmdMatrix44_t& projection);
 
 public:
 	PLUGIN_EXPORT OpenVR();
@@ -34,5 +159,35 @@ public:
 	PLUGIN_EXPORT void PostProcess(CommandBuffer* commandBuffer, Camera* camera) override;
 	PLUGIN_EXPORT void PreSwap() override;
 
+	PLUGIN_EXPORT void MirrorMode(::MirrorMode mode);
+	inline ::MirrorMode MirrorMode() const { return mMirrorMode; }
+	// Maximum rate, in Hz, at which MIRROR_MODE_EYE refreshes the desktop mirror
+	inline void MirrorRate(float hz) { mMirrorRate = hz; }
+
+	// Drives object's local transform with a tracked device's pose (e.g. a controller), or stops doing so
+	PLUGIN_EXPORT void TrackDevice(vr::TrackedDeviceIndex_t device, Object* object);
+	PLUGIN_EXPORT void UntrackDevice(Object* object);
+
+	// Fail startup instead of warning when the engine renders on a different GPU than the HMD's. Only has an effect
+	// before PreDeviceInit; OPENVR_REQUIRE_HMD_GPU in the environment turns it on from the start.
+	inline void RequireHmdDevice(bool require) { mRequireHmdDevice = require; }
+	inline bool RequireHmdDevice() const { return mRequireHmdDevice; }
+
+	// Runs the simulation one frame ahead of display with explicit compositor timing. Off (the serial loop) by default.
+	// Startup only: ignored once PreInstanceInit has connected to the runtime
+	PLUGIN_EXPORT void Pipelined(bool pipelined);
+	inline bool Pipelined() const { return mPipelined; }
+
+	inline QualityGovernor& Governor() { return mGovernor; }
+#ifdef _DEBUG
+	// CPU time, in milliseconds, busy-waited in Update() every frame to simulate a heavier scene
+	PLUGIN_EXPORT void SyntheticLoad(float ms);
+	inline float SyntheticLoad() const { return mSyntheticLoad; }
+#endif
+
+	// Replaces the loaded glTF at a frame boundary, behind a compositor fade, without restarting the VR session. Ignored before Init
+	PLUGIN_EXPORT void SwapScene(const std::string& folder, const std::string& file);
+	inline bool SwappingScene() const { return mSwapState != SCENE_SWAP_NONE; }
+
 	inline int Priority() override { return 1000; }
 };
\ No newline at end of file
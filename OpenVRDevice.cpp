@@ -1,4 +1,5 @@
 #include "OpenVRDevice.hpp"
+#include <chrono>
 
 #pragma region Conversion code
 // Converts to float4x4 format and flips from right-handed to left-handed
@@ -21,11 +22,15 @@ float4x4 OpenVRDevice::ConvertMat44(vr::HmdMatrix44_t mat44) {
 }
 
 OpenVRDevice::OpenVRDevice(float near, float far)
-	: mNearClip(near), mFarClip(far), mSystem(nullptr), mPosition(float3()), mRotation(quaternion()) {
+	: mSystem(nullptr), mNearClip(near), mFarClip(far), mPosition(float3()), mRotation(quaternion()), mPipelined(false), mPoseWaitMs(0),
+	mFrameDuration(1.f / 90.f), mVsyncToPhotons(0.f), mFrameIntervalSum(0), mPoseLatencySum(0), mTimedFrames(0) {
+	mRenderPose = {};
+	mRenderPose.m[0][0] = mRenderPose.m[1][1] = mRenderPose.m[2][2] = 1.f;
 	Init();
 }
 
 OpenVRDevice::~OpenVRDevice() {
+	PrintPipelineTimings();
 	vr::VR_Shutdown();
 }
 
@@ -73,6 +78,10 @@ void OpenVRDevice::Init() {
 	fprintf_color(COLOR_GREEN, stdout, "OpenVR HMD Driver Initialized\Driver name: %s\nDriver serial#: %s\n",
 		driverName, deviceSerialNumber);
 
+	float displayFrequency = mSystem->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_DisplayFrequency_Float);
+	if (displayFrequency > 0) mFrameDuration = 1.f / displayFrequency;
+	mVsyncToPhotons = mSystem->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_SecondsFromVsyncToPhotons_Float);
+
 }
 
 
@@ -152,6 +161,18 @@ std::string OpenVRDevice::GetDeviceProperty(vr::TrackedDeviceIndex_t unDevice, v
 	return result;
 }
 
+VkPhysicalDevice OpenVRDevice::GetOutputDevice(VkInstance instance) {
+	uint64_t device = 0;
+	mSystem->GetOutputDevice(&device, vr::TextureType_Vulkan, (VkInstance_T*)instance);
+	return (VkPhysicalDevice)device;
+}
+
+bool OpenVRDevice::GetFrameTiming(vr::Compositor_FrameTiming& timing, uint32_t framesAgo) {
+	timing = {};
+	timing.m_nSize = sizeof(vr::Compositor_FrameTiming);
+	return vr::VRCompositor()->GetFrameTiming(&timing, framesAgo);
+}
+
 void OpenVRDevice::Shutdown() {
 
 }
@@ -188,15 +209,76 @@ void OpenVRDevice::Update() {
 		}
 	}
 	*/
-	vr::VRCompositor()->WaitGetPoses(mTrackedDevicePoses, vr::k_unMaxTrackedDeviceCount, NULL, 0);
+	if (!mPipelined) {
+		auto t0 = std::chrono::high_resolution_clock::now();
+		vr::VRCompositor()->WaitGetPoses(mTrackedDevicePoses, vr::k_unMaxTrackedDeviceCount, NULL, 0);
+		mPoseWaitMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+		UpdateHeadPose();
+		return;
+	}
+	// Set again by WaitPoses(), at the end of the frame
+	mPoseWaitMs = 0;
+
+	// Pipelined: predict where the head will be when this frame reaches the display, one frame from now, without blocking
+	float secondsSinceVsync;
+	mSystem->GetTimeSinceLastVsync(&secondsSinceVsync, nullptr);
+	float predictedSeconds = mFrameDuration - secondsSinceVsync + mVsyncToPhotons;
+	mSystem->GetDeviceToAbsoluteTrackingPose(vr::TrackingUniverseStanding, predictedSeconds, mTrackedDevicePoses, vr::k_unMaxTrackedDeviceCount);
+	UpdateHeadPose();
+}
+
+void OpenVRDevice::Pipelined(bool pipelined) {
+	vr::VRCompositor()->SetExplicitTimingMode(pipelined ?
+		vr::VRCompositorTimingMode_Explicit_ApplicationPerformsPostPresentHandoff : vr::VRCompositorTimingMode_Implicit);
+	mPipelined = pipelined;
+}
+
+void OpenVRDevice::WaitPoses() {
+	if (!mPipelined) return;
+	// The frame was recorded with the poses predicted in Update and is submitted with them, so nothing is read back here
+	auto t0 = std::chrono::high_resolution_clock::now();
+	vr::VRCompositor()->WaitGetPoses(NULL, 0, NULL, 0);
+	mPoseWaitMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+}
+
+void OpenVRDevice::SubmitTimingData() {
+	if (mPipelined) vr::VRCompositor()->SubmitExplicitTimingData();
+}
+
+void OpenVRDevice::PostPresent() {
+	if (mPipelined) vr::VRCompositor()->PostPresentHandoff();
+
+	vr::Compositor_FrameTiming timing;
+	if (GetFrameTiming(timing)) {
+		mFrameIntervalSum += timing.m_flClientFrameIntervalMs;
+		mPoseLatencySum += timing.m_flNewFrameReadyMs - timing.m_flNewPosesReadyMs;
+		mTimedFrames++;
+	}
+}
+
+void OpenVRDevice::PrintPipelineTimings() {
+	if (!mTimedFrames) return;
+	float interval = FrameInterval();
+	printf("%s frames: %.3fms frame interval (%.1f fps), %.3fms poses-to-frame latency over %u frames\n",
+		mPipelined ? "Pipelined" : "Serial", interval, 1000.f / interval, PoseLatency(), mTimedFrames);
+}
+
+void OpenVRDevice::UpdateHeadPose() {
 	if (mTrackedDevicePoses[vr::k_unTrackedDeviceIndex_Hmd].bPoseIsValid)
 	{
-		mHeadMatrix = ConvertMat34(mTrackedDevicePoses[vr::k_unTrackedDeviceIndex_Hmd].mDeviceToAbsoluteTracking);
+		mRenderPose = mTrackedDevicePoses[vr::k_unTrackedDeviceIndex_Hmd].mDeviceToAbsoluteTracking;
+		mHeadMatrix = ConvertMat34(mRenderPose);
 		mHeadMatrix.Decompose(&mPosition, &mRotation, nullptr);
 		//printf_color(COLOR_MAGENTA, "Head position: %f, %f, %f\nHead rotation: %f, %f, %f, %f\n\n", mPosition.x, mPosition.y, mPosition.z, mRotation.x, mRotation.y, mRotation.z, mRotation.w);
 	}
 }
 
+bool OpenVRDevice::DevicePose(vr::TrackedDeviceIndex_t device, float3& position, quaternion& rotation) {
+	if (device >= vr::k_unMaxTrackedDeviceCount || !mTrackedDevicePoses[device].bPoseIsValid) return false;
+	ConvertMat34(mTrackedDevicePoses[device].mDeviceToAbsoluteTracking).Decompose(&position, &rotation, nullptr);
+	return true;
+}
+
 void OpenVRDevice::ProcessEvent(vr::VREvent_t event) {
 
 }
@@ -286,12 +368,10 @@ void OpenVRDevice::CalculateEyeAdjustment() {
 }
 
 void OpenVRDevice::CalculateProjectionMatrices() {
-	vr::HmdMatrix44_t mat;
-
-	mat = mSystem->GetProjectionMatrix(vr::Eye_Left, mNearClip, mFarClip);
-	mLeftProjection = ConvertMat44(mat);
-	mat = mSystem->GetProjectionMatrix(vr::Eye_Right, mNearClip, mFarClip);
-	mRightProjection = ConvertMat44(mat);
+	mLeftProjectionRaw = mSystem->GetProjectionMatrix(vr::Eye_Left, mNearClip, mFarClip);
+	mLeftProjection = ConvertMat44(mLeftProjectionRaw);
+	mRightProjectionRaw = mSystem->GetProjectionMatrix(vr::Eye_Right, mNearClip, mFarClip);
+	mRightProjection = ConvertMat44(mRightProjectionRaw);
 }
 
 
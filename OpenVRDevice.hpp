@@ -53,10 +53,28 @@ public:
 	void Shutdown();
 	void Update();
 
+	// Off is the serial loop (WaitGetPoses in Update). On runs the simulation one frame ahead of display with
+	// explicit timing: Update only predicts poses, the frame is recorded with them while the previous one is still
+	// on the GPU, and WaitPoses() then blocks until the compositor wants it. Sets the compositor's timing mode, so
+	// call it once, before the first frame
+	void Pipelined(bool pipelined);
+	bool Pipelined() { return mPipelined; }
+	void WaitPoses();
+	// Time this frame spent blocked in WaitGetPoses, in Update or WaitPoses() depending on the mode, in milliseconds
+	inline float PoseWaitMs() const { return mPoseWaitMs; }
+	void SubmitTimingData();
+	void PostPresent();
+	// Averages over every timed frame so far, in milliseconds
+	inline float FrameInterval() const { return mTimedFrames ? (float)(mFrameIntervalSum / mTimedFrames) : 0.f; }
+	inline float PoseLatency() const { return mTimedFrames ? (float)(mPoseLatencySum / mTimedFrames) : 0.f; }
+
 
 	bool GetVulkanInstanceExtensionsRequired(std::vector< std::string >& outInstanceExtensionList);
 	bool GetVulkanDeviceExtensionsRequired(VkPhysicalDevice pPhysicalDevice, std::vector< std::string >& outDeviceExtensionList);
 	std::string GetDeviceProperty(vr::TrackedDeviceIndex_t unDevice, vr::TrackedDeviceProperty prop, vr::TrackedPropertyError* peError = NULL);
+	// The physical device driving the HMD, or VK_NULL_HANDLE if the runtime doesn't say
+	VkPhysicalDevice GetOutputDevice(VkInstance instance);
+	bool GetFrameTiming(vr::Compositor_FrameTiming& timing, uint32_t framesAgo = 0);
 
 	vr::IVRSystem* System() { return mSystem; }
 	float4x4 LeftEyeMatrix() { return mLeftEyeTransform; }
@@ -66,6 +84,16 @@ public:
 
 	float3 Position() { return mPosition; }
 	quaternion Rotation() { return mRotation; }
+	// Pose of any tracked device from the last WaitPoses()/Update(), false if the runtime has no valid pose for it
+	bool DevicePose(vr::TrackedDeviceIndex_t device, float3& position, quaternion& rotation);
+
+	float FrameDuration() { return mFrameDuration; }
+	float NearClip() { return mNearClip; }
+	float FarClip() { return mFarClip; }
+	// Raw OpenVR matrices, as passed back to the compositor with each submitted eye
+	vr::HmdMatrix34_t RenderPose() { return mRenderPose; }
+	vr::HmdMatrix44_t LeftProjectionRaw() { return mLeftProjectionRaw; }
+	vr::HmdMatrix44_t RightProjectionRaw() { return mRightProjectionRaw; }
 
 protected:
 	vr::IVRRenderModels* mRenderModels;
@@ -77,15 +105,28 @@ protected:
 
 	float4x4 mLeftEyeTransform, mRightEyeTransform;
 	float4x4 mLeftProjection, mRightProjection;
+	vr::HmdMatrix44_t mLeftProjectionRaw, mRightProjectionRaw;
 	float mNearClip, mFarClip;
 
 	float4x4 mHeadMatrix;
+	vr::HmdMatrix34_t mRenderPose;
 	float3 mPosition;
 	quaternion mRotation;
 
+	bool mPipelined;
+	float mPoseWaitMs;
+	float mFrameDuration;
+	float mVsyncToPhotons;
+	// Compositor timing accumulated over the session
+	double mFrameIntervalSum;
+	double mPoseLatencySum;
+	uint32_t mTimedFrames;
+
 	void InitializeActions();
 	void ProcessEvent(vr::VREvent_t event);
 	void UpdateTracking();
+	void UpdateHeadPose();
+	void PrintPipelineTimings();
 
 	float4x4 ConvertMat34(vr::HmdMatrix34_t);
 	float4x4 ConvertMat44(vr::HmdMatrix44_t);
@@ -0,0 +1,168 @@
+#include "PerformanceHud.hpp"
+#include <Core/Buffer.hpp>
+#include <Core/CommandBuffer.hpp>
+#include <Core/Device.hpp>
+#include <cstring>
+
+using namespace std;
+
+#pragma region Font
+// 3x5 glyphs, one bit per pixel, rows top to bottom
+static const char* gGlyphChars = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ.:%-";
+static const uint16_t gGlyphs[] = {
+	0x7b6f, 0x2c97, 0x73e7, 0x73cf, 0x5bc9, 0x79cf, 0x79ef, 0x7249, 0x7bef, 0x7bcf,
+	0x2bed, 0x6bae, 0x3923, 0x6b6e, 0x79a7, 0x79a4, 0x396b, 0x5bed, 0x7497, 0x126a,
+	0x5bad, 0x4927, 0x5fed, 0x6b6d, 0x2b6a, 0x6ba4, 0x2b73, 0x6bad, 0x388e, 0x7492,
+	0x5b6f, 0x5b6a, 0x5bfd, 0x5aad, 0x5a92, 0x72a7, 0x0002, 0x0410, 0x52a5, 0x01c0
+};
+static const uint32_t gGlyphScale = 4;
+static const uint32_t gLineHeight = 7 * gGlyphScale;
+
+// RGBA8, little endian
+static const uint32_t gBackground = 0xA0000000;
+static const uint32_t gWhite = 0xFFFFFFFF;
+static const uint32_t gYellow = 0xFF00FFFF;
+static const uint32_t gRed = 0xFF0000FF;
+#pragma endregion
+
+PerformanceHud::PerformanceHud(Device* device, ImageStateTracker& tracker, uint32_t width, uint32_t height)
+	: mDevice(device), mTracker(tracker), mOverlay(vr::k_ulOverlayHandleInvalid), mVisible(false), mDrawn(false), mUploaded(false), mUploadInFlight(false), mRate(10.f), mStats({}) {
+	mTexture = new Texture("Performance HUD", device, width, height, 1,
+		VK_FORMAT_R8G8B8A8_UNORM,
+		VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+	mTracker.Import(mTexture->Image(), VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+	mStaging = new Buffer("Performance HUD Staging", device, width * height * sizeof(uint32_t),
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	VkEventCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_EVENT_CREATE_INFO;
+	vkCreateEvent(*mDevice, &info, nullptr, &mUploadEvent);
+
+	vr::EVROverlayError error = vr::VROverlay()->CreateOverlay("vratum.performance", "Performance", &mOverlay);
+	if (error != vr::VROverlayError_None) {
+		fprintf_color(COLOR_RED, stderr, "Error: Unable to create performance overlay: %s\n", vr::VROverlay()->GetOverlayErrorNameFromEnum(error));
+		mOverlay = vr::k_ulOverlayHandleInvalid;
+		return;
+	}
+	vr::VROverlay()->SetOverlayWidthInMeters(mOverlay, .25f);
+}
+PerformanceHud::~PerformanceHud() {
+	if (mOverlay != vr::k_ulOverlayHandleInvalid)
+		vr::VROverlay()->DestroyOverlay(mOverlay);
+	vkDestroyEvent(*mDevice, mUploadEvent, nullptr);
+	delete mStaging;
+	delete mTexture;
+}
+
+void PerformanceHud::Show(vr::TrackedDeviceIndex_t trackedDevice) {
+	if (mOverlay == vr::k_ulOverlayHandleInvalid) return;
+
+	// Slightly below and in front of the device
+	vr::HmdMatrix34_t transform = {};
+	transform.m[0][0] = transform.m[1][1] = transform.m[2][2] = 1.f;
+	transform.m[1][3] = -.2f;
+	transform.m[2][3] = -.8f;
+	vr::VROverlay()->SetOverlayTransformTrackedDeviceRelative(mOverlay, trackedDevice, &transform);
+	vr::VROverlay()->ShowOverlay(mOverlay);
+	mVisible = true;
+	mLastDraw = {};
+}
+void PerformanceHud::Hide() {
+	if (mOverlay != vr::k_ulOverlayHandleInvalid)
+		vr::VROverlay()->HideOverlay(mOverlay);
+	mVisible = false;
+}
+
+void PerformanceHud::DrawString(uint32_t* pixels, uint32_t x, uint32_t y, const char* str, uint32_t color) {
+	for (; *str; str++, x += 4 * gGlyphScale) {
+		const char* c = strchr(gGlyphChars, *str);
+		if (*str == ' ' || !c) continue;
+		uint16_t glyph = gGlyphs[c - gGlyphChars];
+		for (uint32_t gy = 0; gy < 5 * gGlyphScale; gy++)
+			for (uint32_t gx = 0; gx < 3 * gGlyphScale; gx++) {
+				uint32_t px = x + gx;
+				uint32_t py = y + gy;
+				if (px >= mTexture->Width() || py >= mTexture->Height()) continue;
+				if (glyph & (1 << (14 - (gy / gGlyphScale) * 3 - gx / gGlyphScale)))
+					pixels[py * mTexture->Width() + px] = color;
+			}
+	}
+}
+
+void PerformanceHud::Draw() {
+	uint32_t* pixels = (uint32_t*)mStaging->MappedData();
+	for (uint32_t i = 0; i < mTexture->Width() * mTexture->Height(); i++)
+		pixels[i] = gBackground;
+
+	char line[32];
+	uint32_t y = gGlyphScale;
+	uint32_t frameColor = mStats.mFrameTime > mStats.mBudget * 1.05f ? gRed : mStats.mFrameTime > mStats.mBudget * .9f ? gYellow : gWhite;
+	snprintf(line, 32, "FRAME  %5.2fMS", mStats.mFrameTime);
+	DrawString(pixels, gGlyphScale, y, line, frameColor); y += gLineHeight;
+	snprintf(line, 32, "GPU    %5.2fMS", mStats.mGpuTime);
+	DrawString(pixels, gGlyphScale, y, line, mStats.mGpuTime > mStats.mBudget ? gRed : gWhite); y += gLineHeight;
+	snprintf(line, 32, "MISSED %u", mStats.mMissedFrames);
+	DrawString(pixels, gGlyphScale, y, line, gWhite); y += gLineHeight;
+	snprintf(line, 32, "REPROJ %u", mStats.mReprojectedFrames);
+	DrawString(pixels, gGlyphScale, y, line, gWhite); y += gLineHeight;
+	snprintf(line, 32, "SCALE  %.2f", mStats.mRenderScale);
+	DrawString(pixels, gGlyphScale, y, line, gWhite); y += gLineHeight;
+	DrawString(pixels, gGlyphScale, y, mStats.mPipelined ? "MODE   PIPELINED" : "MODE   SERIAL", gWhite); y += gLineHeight;
+	snprintf(line, 32, "LAT    %5.2fMS", mStats.mPoseLatency);
+	DrawString(pixels, gGlyphScale, y, line, gWhite);
+}
+
+void PerformanceHud::Update() {
+	if (!mVisible) return;
+	auto now = chrono::high_resolution_clock::now();
+	if (chrono::duration<float>(now - mLastDraw).count() < 1.f / mRate) return;
+
+	// Poll, never wait: mStaging is only rewritten once its event shows the previous upload has read it
+	if (mUploadInFlight) {
+		if (vkGetEventStatus(*mDevice, mUploadEvent) != VK_EVENT_SET) return;
+		vkResetEvent(*mDevice, mUploadEvent);
+		mUploadInFlight = false;
+	}
+	mLastDraw = now;
+
+	Draw();
+	mTracker.Transition(mTexture->Image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, true);
+	mDrawn = true;
+}
+
+void PerformanceHud::Record(CommandBuffer* commandBuffer) {
+	if (!mDrawn) return;
+	mDrawn = false;
+
+	VkBufferImageCopy copy = {};
+	copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	copy.imageSubresource.layerCount = 1;
+	copy.imageExtent = { mTexture->Width(), mTexture->Height(), 1 };
+	vkCmdCopyBufferToImage(*commandBuffer, *mStaging, mTexture->Image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+	vkCmdSetEvent(*commandBuffer, mUploadEvent, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	mUploadInFlight = true;
+
+	// The compositor reads overlays the same way as submitted eyes
+	mTracker.Transition(mTexture->Image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	mUploaded = true;
+}
+
+void PerformanceHud::Submit() {
+	if (!mUploaded) return;
+	mUploaded = false;
+
+	vr::VRVulkanTextureData_t vulkanData;
+	vulkanData.m_nImage = (uint64_t)(mTexture->Image());
+	vulkanData.m_pDevice = *mDevice;
+	vulkanData.m_pPhysicalDevice = mDevice->PhysicalDevice();
+	vulkanData.m_pInstance = *mDevice->Instance();
+	vulkanData.m_pQueue = mDevice->GraphicsQueue();
+	vulkanData.m_nQueueFamilyIndex = mDevice->GraphicsQueueFamily();
+	vulkanData.m_nHeight = mTexture->Height();
+	vulkanData.m_nWidth = mTexture->Width();
+	vulkanData.m_nFormat = mTexture->Format();
+	vulkanData.m_nSampleCount = mTexture->SampleCount();
+
+	vr::Texture_t texture = { &vulkanData, vr::TextureType_Vulkan, vr::ColorSpace_Auto };
+	vr::VROverlay()->SetOverlayTexture(mOverlay, &texture);
+}
\ No newline at end of file
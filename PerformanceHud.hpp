@@ -0,0 +1,64 @@
+#pragma once
+
+#include <Content/Texture.hpp>
+#include <openvr.h>
+#include <chrono>
+
+#include "ImageStateTracker.hpp"
+
+class Buffer;
+
+struct PerformanceStats {
+	float mFrameTime;
+	float mGpuTime;
+	float mBudget;
+	uint32_t mMissedFrames;
+	uint32_t mReprojectedFrames;
+	float mRenderScale;
+	bool mPipelined;
+	// Average time from the poses a frame was rendered with being ready to the frame being ready
+	float mPoseLatency;
+};
+
+// Frame statistics drawn into a small texture at a low rate and shown as a compositor overlay,
+// so it costs nothing in the eye passes and is not affected by reprojection
+class PerformanceHud {
+public:
+	PerformanceHud(Device* device, ImageStateTracker& tracker, uint32_t width = 256, uint32_t height = 192);
+	~PerformanceHud();
+
+	// Attaches the HUD to a tracked device, the HMD by default
+	void Show(vr::TrackedDeviceIndex_t trackedDevice = vr::k_unTrackedDeviceIndex_Hmd);
+	void Hide();
+	inline bool Visible() const { return mVisible; }
+	// Maximum rate, in Hz, at which the HUD is redrawn
+	inline void Rate(float hz) { mRate = hz; }
+	inline void Stats(const PerformanceStats& stats) { mStats = stats; }
+
+	// Redraws the HUD if it is visible and due, queueing the upload's transition on the tracker
+	void Update();
+	// Records the upload queued by Update(), once the tracker's barriers were flushed
+	void Record(CommandBuffer* commandBuffer);
+	// Hands a freshly uploaded texture to the overlay, once the frame's command buffer was submitted
+	void Submit();
+
+private:
+	Device* mDevice;
+	ImageStateTracker& mTracker;
+	Texture* mTexture;
+	Buffer* mStaging;
+	// Set by the GPU once the last recorded upload has read mStaging
+	VkEvent mUploadEvent;
+	vr::VROverlayHandle_t mOverlay;
+
+	bool mVisible;
+	bool mDrawn;
+	bool mUploaded;
+	bool mUploadInFlight;
+	float mRate;
+	std::chrono::high_resolution_clock::time_point mLastDraw;
+	PerformanceStats mStats;
+
+	void Draw();
+	void DrawString(uint32_t* pixels, uint32_t x, uint32_t y, const char* str, uint32_t color);
+};
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "QualityGovernor.hpp"
+#include <cstdio>
+
+using namespace std;
+
+QualityGovernor::QualityGovernor()
+	: mLevel(0), mEnabled(true), mCpuTimes{}, mGpuTimes{}, mSamples(0), mHeadroomFrames(0), mBackOff(.9f), mRecover(.7f), mRecoveryFrames(180) {
+	Ladder({
+		{ "Full", 30.f, 1, true },
+		{ "Short shadows", 15.f, 1, true },
+		{ "Ambient only", 5.f, 1, false },
+	});
+}
+
+void QualityGovernor::Ladder(const vector<QualityLevel>& levels) {
+	mLevels = levels;
+	mLevel = 0;
+	mSamples = mHeadroomFrames = 0;
+}
+
+void QualityGovernor::Step(uint32_t level, float cpuMs, float gpuMs, float budgetMs) {
+	printf("Quality: %s -> %s (%.2fms CPU, %.2fms GPU over the last %u frames, budget %.2fms)\n",
+		mLevels[mLevel].mName, mLevels[level].mName, cpuMs, gpuMs, WindowSize, budgetMs);
+	mLevel = level;
+	// The new level is judged on its own frames only
+	mSamples = mHeadroomFrames = 0;
+}
+
+bool QualityGovernor::Update(float frameMs, float waitMs, float gpuMs, float budgetMs) {
+	if (!mEnabled || mLevels.empty()) return false;
+
+	mCpuTimes[mSamples % WindowSize] = frameMs > waitMs ? frameMs - waitMs : 0.f;
+	mGpuTimes[mSamples % WindowSize] = gpuMs;
+	mSamples++;
+	if (mSamples < WindowSize) return false;
+
+	float cpu = 0, gpu = 0;
+	for (uint32_t i = 0; i < WindowSize; i++) {
+		cpu += mCpuTimes[i];
+		gpu += mGpuTimes[i];
+	}
+	cpu /= WindowSize;
+	gpu /= WindowSize;
+	float worst = cpu > gpu ? cpu : gpu;
+
+	// Missing a frame in VR means reprojection, so back off immediately...
+	if (worst > budgetMs * mBackOff) {
+		mHeadroomFrames = 0;
+		if (mLevel + 1 >= mLevels.size()) return false;
+		Step(mLevel + 1, cpu, gpu, budgetMs);
+		return true;
+	}
+	// ...but only recover after a sustained stretch of headroom, to avoid oscillating around the budget
+	if (worst < budgetMs * mRecover) {
+		if (++mHeadroomFrames < mRecoveryFrames || mLevel == 0) return false;
+		Step(mLevel - 1, cpu, gpu, budgetMs);
+		return true;
+	}
+	mHeadroomFrames = 0;
+	return false;
+}
\ No newline at end of file
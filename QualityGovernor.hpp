@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct QualityLevel {
+	const char* mName;
+	float mShadowDistance;
+	uint32_t mCascadeCount;
+	// Scene lights contribute, otherwise only the environment's ambient light is left
+	bool mDirectLighting;
+};
+
+// Picks a QualityLevel from rolling CPU and GPU frame times. Steps down as soon as the recent average gets close to
+// the frame budget, and only steps back up after a long run of frames with plenty of headroom. Levels should only
+// change settings that are cheap to switch, nothing that makes the engine build new pipelines while over budget.
+class QualityGovernor {
+public:
+	QualityGovernor();
+
+	// Levels from best to cheapest; resets to the first one
+	void Ladder(const std::vector<QualityLevel>& levels);
+	inline const QualityLevel& Level() const { return mLevels[mLevel]; }
+	inline uint32_t LevelIndex() const { return mLevel; }
+
+	inline void Enabled(bool enabled) { mEnabled = enabled; mSamples = mHeadroomFrames = 0; }
+	inline bool Enabled() const { return mEnabled; }
+
+	// Fraction of the budget above which the level steps down, and below which it may recover
+	inline void Thresholds(float backOff, float recover) { mBackOff = backOff; mRecover = recover; }
+	// Consecutive frames under the recovery threshold before stepping back up
+	inline void RecoveryFrames(uint32_t frames) { mRecoveryFrames = frames; }
+
+	// Adds a frame's timings, returns true if the level changed. waitMs is the part of frameMs the CPU spent blocked on
+	// the compositor, it is not work a cheaper level would save and is left out of the CPU time
+	bool Update(float frameMs, float waitMs, float gpuMs, float budgetMs);
+
+private:
+	static const uint32_t WindowSize = 8;
+
+	std::vector<QualityLevel> mLevels;
+	uint32_t mLevel;
+	bool mEnabled;
+
+	float mCpuTimes[WindowSize];
+	float mGpuTimes[WindowSize];
+	uint32_t mSamples;
+	uint32_t mHeadroomFrames;
+
+	float mBackOff;
+	float mRecover;
+	uint32_t mRecoveryFrames;
+
+	void Step(uint32_t level, float cpuMs, float gpuMs, float budgetMs);
+};
\ No newline at end of file
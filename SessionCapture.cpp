@@ -0,0 +1,185 @@
+#include "SessionCapture.hpp"
+#include <Core/Buffer.hpp>
+#include <Core/CommandBuffer.hpp>
+#include <Core/Device.hpp>
+#include <cstring>
+
+using namespace std;
+
+SessionCapture::SessionCapture(Device* device, ImageStateTracker& tracker, uint32_t width, uint32_t height, uint32_t ringSize)
+	: mDevice(device), mTracker(tracker), mSlotCount(ringSize), mRecordSlot(0), mCapturing(false), mFile(nullptr),
+	mCapturedFrames(0), mDroppedFrames(0), mWrittenFrames(0), mExit(false) {
+	mTexture = new Texture("Session Capture", device, width, height, 1,
+		VK_FORMAT_R8G8B8A8_SRGB,
+		VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+	mTracker.Import(mTexture->Image(), VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
+	mSlots = new Slot[mSlotCount];
+	for (uint32_t i = 0; i < mSlotCount; i++) {
+		mSlots[i].mBuffer = new Buffer("Session Capture Readback", device, width * height * sizeof(uint32_t),
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		VkEventCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_EVENT_CREATE_INFO;
+		vkCreateEvent(*mDevice, &info, nullptr, &mSlots[i].mEvent);
+		mSlots[i].mHeader = {};
+		mSlots[i].mState = SLOT_FREE;
+	}
+
+	mWriter = thread(&SessionCapture::WriterThread, this);
+}
+SessionCapture::~SessionCapture() {
+	// Anything still on the GPU is dropped, only frames already handed to the writer are finished
+	{
+		lock_guard<mutex> lock(mQueueMutex);
+		mExit = true;
+	}
+	mQueueCondition.notify_all();
+	mWriter.join();
+	mCapturing = false;
+	if (mFile) {
+		fclose(mFile);
+		mFile = nullptr;
+	}
+
+	for (uint32_t i = 0; i < mSlotCount; i++) {
+		vkDestroyEvent(*mDevice, mSlots[i].mEvent, nullptr);
+		delete mSlots[i].mBuffer;
+	}
+	delete[] mSlots;
+	delete mTexture;
+}
+
+bool SessionCapture::Start(const string& path) {
+	if (mCapturing) return true;
+	if (mFile) {
+		fprintf_color(COLOR_YELLOW, stderr, "Warning: Previous capture %s is still being written\n", mPath.c_str());
+		return false;
+	}
+
+	mFile = fopen(path.c_str(), "wb");
+	if (!mFile) {
+		fprintf_color(COLOR_RED, stderr, "Error: Unable to open %s for capture\n", path.c_str());
+		return false;
+	}
+	CaptureFileHeader header = {};
+	memcpy(header.mMagic, "VRCP", 4);
+	header.mVersion = 1;
+	header.mWidth = mTexture->Width();
+	header.mHeight = mTexture->Height();
+	fwrite(&header, sizeof(CaptureFileHeader), 1, mFile);
+
+	mPath = path;
+	mStartTime = chrono::high_resolution_clock::now();
+	mCapturedFrames = mDroppedFrames = 0;
+	mWrittenFrames = 0;
+	mCapturing = true;
+	printf("Capturing to %s (%ux%u)\n", mPath.c_str(), mTexture->Width(), mTexture->Height());
+	return true;
+}
+void SessionCapture::Stop() {
+	mCapturing = false;
+	Finish();
+}
+
+void SessionCapture::Finish() {
+	if (mCapturing || !mFile) return;
+	for (uint32_t i = 0; i < mSlotCount; i++)
+		if (mSlots[i].mState != SLOT_FREE) return;
+
+	fclose(mFile);
+	mFile = nullptr;
+	printf("Capture: %u frames written to %s, %u of %u dropped because every readback buffer was in flight\n",
+		mWrittenFrames.load(), mPath.c_str(), mDroppedFrames, mCapturedFrames + mDroppedFrames);
+}
+
+void SessionCapture::WriterThread() {
+	while (true) {
+		uint32_t i;
+		{
+			unique_lock<mutex> lock(mQueueMutex);
+			mQueueCondition.wait(lock, [&]() { return mExit || !mWriteQueue.empty(); });
+			if (mWriteQueue.empty()) return;
+			i = mWriteQueue.front();
+			mWriteQueue.pop();
+		}
+
+		Slot& slot = mSlots[i];
+		fwrite(&slot.mHeader, sizeof(CaptureFrameHeader), 1, mFile);
+		fwrite(slot.mBuffer->MappedData(), 1, mTexture->Width() * mTexture->Height() * sizeof(uint32_t), mFile);
+		mWrittenFrames++;
+		slot.mState = SLOT_FREE;
+	}
+}
+
+bool SessionCapture::Prepare() {
+	// Poll, never wait: a buffer is only touched by the CPU once its event shows the copy has finished
+	for (uint32_t i = 0; i < mSlotCount; i++) {
+		Slot& slot = mSlots[i];
+		if (slot.mState != SLOT_IN_FLIGHT || vkGetEventStatus(*mDevice, slot.mEvent) != VK_EVENT_SET) continue;
+		vkResetEvent(*mDevice, slot.mEvent);
+		slot.mState = SLOT_WRITING;
+		{
+			lock_guard<mutex> lock(mQueueMutex);
+			mWriteQueue.push(i);
+		}
+		mQueueCondition.notify_one();
+	}
+	Finish();
+
+	if (!mCapturing) return false;
+
+	for (uint32_t i = 0; i < mSlotCount; i++) {
+		uint32_t slot = (mRecordSlot + i) % mSlotCount;
+		if (mSlots[slot].mState == SLOT_FREE) {
+			mRecordSlot = slot;
+			mTracker.Transition(mTexture->Image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, true);
+			return true;
+		}
+	}
+	mDroppedFrames++;
+	return false;
+}
+
+void SessionCapture::Record(CommandBuffer* commandBuffer, Texture* leftEye, Texture* rightEye, uint64_t frame, const vr::HmdMatrix34_t& pose) {
+	Slot& slot = mSlots[mRecordSlot];
+	slot.mHeader.mFrame = frame;
+	slot.mHeader.mTime = chrono::duration<double>(chrono::high_resolution_clock::now() - mStartTime).count();
+	slot.mHeader.mPose = pose;
+
+	VkImageSubresourceLayers layers = {};
+	layers.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	layers.layerCount = 1;
+
+	int32_t half = (int32_t)mTexture->Width() / 2;
+	VkImageBlit blit = {};
+	blit.srcSubresource = layers;
+	blit.srcOffsets[1] = { (int32_t)leftEye->Width(), (int32_t)leftEye->Height(), 1 };
+	blit.dstSubresource = layers;
+	blit.dstOffsets[1] = { half, (int32_t)mTexture->Height(), 1 };
+	vkCmdBlitImage(*commandBuffer, leftEye->Image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mTexture->Image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+	blit.srcOffsets[1] = { (int32_t)rightEye->Width(), (int32_t)rightEye->Height(), 1 };
+	blit.dstOffsets[0] = { half, 0, 0 };
+	blit.dstOffsets[1] = { 2 * half, (int32_t)mTexture->Height(), 1 };
+	vkCmdBlitImage(*commandBuffer, rightEye->Image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mTexture->Image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+	mTracker.Transition(mTexture->Image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	mTracker.Flush(*commandBuffer);
+
+	VkBufferImageCopy copy = {};
+	copy.imageSubresource = layers;
+	copy.imageExtent = { mTexture->Width(), mTexture->Height(), 1 };
+	vkCmdCopyImageToBuffer(*commandBuffer, mTexture->Image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, *slot.mBuffer, 1, &copy);
+
+	// Make the copy visible to the host before the event tells the CPU it may read the buffer
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(*commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	vkCmdSetEvent(*commandBuffer, slot.mEvent, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	slot.mState = SLOT_IN_FLIGHT;
+	mRecordSlot = (mRecordSlot + 1) % mSlotCount;
+	mCapturedFrames++;
+}
\ No newline at end of file
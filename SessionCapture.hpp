@@ -0,0 +1,89 @@
+#pragma once
+
+#include <Content/Texture.hpp>
+#include <openvr.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+#include "ImageStateTracker.hpp"
+
+class Buffer;
+
+// Records the submitted eyes, downscaled side by side, to a raw file. Frames are copied into a ring of
+// host-visible buffers and only read back once the GPU has signalled them, some frames later, by a
+// writer thread; when every buffer is still in flight the frame is dropped instead of waiting.
+//
+// File layout: CaptureFileHeader, then per frame a CaptureFrameHeader followed by width * height RGBA8 (sRGB) pixels
+class SessionCapture {
+public:
+	struct CaptureFileHeader {
+		char mMagic[4]; // "VRCP"
+		uint32_t mVersion;
+		uint32_t mWidth;
+		uint32_t mHeight;
+	};
+	struct CaptureFrameHeader {
+		uint64_t mFrame;
+		// Seconds since Start(), taken when the frame was recorded
+		double mTime;
+		// HMD pose the frame was rendered with, as submitted to the compositor
+		vr::HmdMatrix34_t mPose;
+	};
+
+	SessionCapture(Device* device, ImageStateTracker& tracker, uint32_t width, uint32_t height, uint32_t ringSize = 4);
+	~SessionCapture();
+
+	bool Start(const std::string& path);
+	// Stops capturing new frames; frames already in flight are still written
+	void Stop();
+	inline bool Capturing() const { return mCapturing; }
+
+	// Hands finished readbacks to the writer, and if capturing picks a free buffer for this frame and queues the
+	// capture texture's transition on the tracker. Returns false if this frame is not captured.
+	bool Prepare();
+	// Downscales both eyes (in TRANSFER_SRC_OPTIMAL) into the capture texture and copies it to this frame's buffer
+	void Record(CommandBuffer* commandBuffer, Texture* leftEye, Texture* rightEye, uint64_t frame, const vr::HmdMatrix34_t& pose);
+
+private:
+	enum SlotState {
+		SLOT_FREE,
+		SLOT_IN_FLIGHT,	// Recorded, waiting on the GPU
+		SLOT_WRITING,	// Owned by the writer thread
+	};
+	struct Slot {
+		Buffer* mBuffer;
+		VkEvent mEvent;
+		CaptureFrameHeader mHeader;
+		std::atomic<uint32_t> mState;
+	};
+
+	Device* mDevice;
+	ImageStateTracker& mTracker;
+	Texture* mTexture;
+	Slot* mSlots;
+	uint32_t mSlotCount;
+	uint32_t mRecordSlot;
+
+	bool mCapturing;
+	std::string mPath;
+	FILE* mFile;
+	std::chrono::high_resolution_clock::time_point mStartTime;
+	uint32_t mCapturedFrames;
+	uint32_t mDroppedFrames;
+	std::atomic<uint32_t> mWrittenFrames;
+
+	std::thread mWriter;
+	std::mutex mQueueMutex;
+	std::condition_variable mQueueCondition;
+	std::queue<uint32_t> mWriteQueue;
+	bool mExit;
+
+	void WriterThread();
+	// Closes the file once nothing is left in flight or queued
+	void Finish();
+};
\ No newline at end of file
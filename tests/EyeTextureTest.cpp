@@ -0,0 +1,77 @@
+#undef NDEBUG
+#include "../EyeTexture.hpp"
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <initializer_list>
+
+static bool Near(float a, float b) { return fabsf(a - b) <= 1e-3f * fmaxf(1.f, fabsf(b)); }
+
+// Same layout as IVRSystem::GetProjectionMatrix, with symmetric 45 degree half-angles
+static vr::HmdMatrix44_t Projection(float nearClip, float farClip, bool reversed) {
+	vr::HmdMatrix44_t m = {};
+	m.m[0][0] = 1.f;
+	m.m[1][1] = 1.f;
+	m.m[3][2] = -1.f;
+	if (reversed) {
+		m.m[2][2] = nearClip / (farClip - nearClip);
+		m.m[2][3] = farClip * nearClip / (farClip - nearClip);
+	} else {
+		m.m[2][2] = farClip / (nearClip - farClip);
+		m.m[2][3] = farClip * nearClip / (nearClip - farClip);
+	}
+	return m;
+}
+
+// Stands in for the engine: the depth value rasterized for a point straight ahead at distance
+static float Rasterize(const vr::HmdMatrix44_t& m, float distance) {
+	return (m.m[2][2] * -distance + m.m[2][3]) / (m.m[3][2] * -distance + m.m[3][3]);
+}
+
+// Stands in for the compositor: the distance a depth value is reconstructed to from what was submitted, or -1 when
+// the value falls outside the submitted range
+static float Reconstruct(const vr::VRTextureDepthInfo_t& depth, float value) {
+	float lo = fminf(depth.vRange.v[0], depth.vRange.v[1]);
+	float hi = fmaxf(depth.vRange.v[0], depth.vRange.v[1]);
+	if (value < lo - 1e-5f || value > hi + 1e-5f) return -1.f;
+	const vr::HmdMatrix44_t& m = depth.mProjection;
+	return -(m.m[2][3] - value * m.m[3][3]) / (value * m.m[3][2] - m.m[2][2]);
+}
+
+int main() {
+	const float nearClip = .1f;
+	const float farClip = 100.f;
+	vr::VRVulkanTextureData_t color = {};
+	vr::VRVulkanTextureData_t depth = {};
+	vr::HmdMatrix34_t pose = {};
+	pose.m[0][0] = pose.m[1][1] = pose.m[2][2] = 1.f;
+	pose.m[1][3] = 1.7f;
+
+	// Without a depth texture only the pose goes along
+	vr::VRTextureWithPoseAndDepth_t texture;
+	vr::HmdMatrix44_t projection = Projection(nearClip, farClip, false);
+	assert(EyeTexture(texture, &color, nullptr, pose, projection, nearClip, farClip) == vr::Submit_TextureWithPose);
+	assert(texture.handle == &color && !texture.depth.handle);
+	assert(texture.eType == vr::TextureType_Vulkan && texture.eColorSpace == vr::ColorSpace_Gamma);
+	assert(texture.mDeviceToAbsoluteTracking.m[1][3] == 1.7f);
+
+	for (bool reversed : { false, true }) {
+		projection = Projection(nearClip, farClip, reversed);
+		vr::EVRSubmitFlags flags = EyeTexture(texture, &color, &depth, pose, projection, nearClip, farClip);
+		assert(flags == (vr::Submit_TextureWithPose | vr::Submit_TextureWithDepth));
+		assert(texture.depth.handle == &depth);
+		assert(texture.depth.mProjection.m[2][2] == projection.m[2][2] && texture.depth.mProjection.m[2][3] == projection.m[2][3]);
+
+		// The range follows the projection: near at 0 and far at 1, or the other way around with reversed-Z
+		assert(Near(texture.depth.vRange.v[0], reversed ? 1.f : 0.f));
+		assert(Near(texture.depth.vRange.v[1], reversed ? 0.f : 1.f));
+
+		// Whatever the engine rasterizes between the planes lands inside the range and comes back at its distance
+		for (float distance : { nearClip, .5f, 2.f, 30.f, farClip })
+			assert(Near(Reconstruct(texture.depth, Rasterize(projection, distance)), distance));
+	}
+
+	printf("EyeTextureTest passed\n");
+	return 0;
+}
\ No newline at end of file
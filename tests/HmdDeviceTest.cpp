@@ -0,0 +1,36 @@
+#undef NDEBUG
+#include "../HmdDevice.hpp"
+
+#include <cassert>
+#include <cstdio>
+#include <initializer_list>
+
+int main() {
+	VkPhysicalDevice engine = (VkPhysicalDevice)0x1000;
+	VkPhysicalDevice other = (VkPhysicalDevice)0x2000;
+
+	// Stands in for IVRSystem::GetOutputDevice, counting how often the runtime is asked
+	uint32_t queries = 0;
+	VkPhysicalDevice reported = VK_NULL_HANDLE;
+	auto outputDevice = [&]() { queries++; return reported; };
+
+	VkPhysicalDevice hmd = other;
+	for (bool require : { false, true }) {
+		// Same GPU, whether or not it is required
+		reported = engine;
+		assert(CheckHmdDevice(engine, outputDevice, require, hmd) == HMD_DEVICE_MATCH && hmd == engine);
+		// A runtime that doesn't report a GPU can't be held against the engine's choice
+		reported = VK_NULL_HANDLE;
+		assert(CheckHmdDevice(engine, outputDevice, require, hmd) == HMD_DEVICE_UNKNOWN && hmd == VK_NULL_HANDLE);
+	}
+
+	// Different GPUs warn by default, and refuse to start when required
+	reported = other;
+	assert(CheckHmdDevice(engine, outputDevice, false, hmd) == HMD_DEVICE_MISMATCH && hmd == other);
+	assert(CheckHmdDevice(engine, outputDevice, true, hmd) == HMD_DEVICE_REFUSED && hmd == other);
+
+	assert(queries == 6);
+
+	printf("HmdDeviceTest passed\n");
+	return 0;
+}
\ No newline at end of file
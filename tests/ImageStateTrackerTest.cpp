@@ -0,0 +1,65 @@
+#undef NDEBUG
+#include "../ImageStateTracker.hpp"
+
+#include <cassert>
+#include <cstdio>
+
+// Stands in for the driver: remembers what the last Flush() recorded
+static uint32_t gCalls = 0;
+static VkPipelineStageFlags gSrcStage = 0;
+static VkPipelineStageFlags gDstStage = 0;
+static std::vector<VkImageMemoryBarrier> gBarriers;
+
+VKAPI_ATTR void VKAPI_CALL vkCmdPipelineBarrier(VkCommandBuffer, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkDependencyFlags,
+	uint32_t, const VkMemoryBarrier*, uint32_t, const VkBufferMemoryBarrier*, uint32_t imageMemoryBarrierCount, const VkImageMemoryBarrier* pImageMemoryBarriers) {
+	gCalls++;
+	gSrcStage = srcStageMask;
+	gDstStage = dstStageMask;
+	gBarriers.assign(pImageMemoryBarriers, pImageMemoryBarriers + imageMemoryBarrierCount);
+}
+
+int main() {
+	VkImage a = (VkImage)0x1;
+	VkImage b = (VkImage)0x2;
+	ImageStateTracker tracker;
+
+	// Read after read in the same layout is elided
+	tracker.Import(a, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	tracker.Transition(a, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	assert(tracker.PendingBarriers().empty());
+	tracker.Flush(VK_NULL_HANDLE);
+	assert(gCalls == 0);
+
+	// ...but a later write waits on every reader, and only writes are made available
+	tracker.Transition(a, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	tracker.Transition(a, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	assert(tracker.PendingBarriers().size() == 1);
+	assert(tracker.PendingBarriers()[0].srcAccessMask == 0);
+	assert(tracker.PendingBarriers()[0].oldLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+	tracker.Flush(VK_NULL_HANDLE);
+	assert(gCalls == 1 && gSrcStage == (VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT) && gDstStage == VK_PIPELINE_STAGE_TRANSFER_BIT);
+	assert(tracker.PendingBarriers().empty());
+
+	// Two transitions of one image in a batch become a single barrier to the final state
+	tracker.Transition(a, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	tracker.Transition(a, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	assert(tracker.PendingBarriers().size() == 1);
+	assert(tracker.PendingBarriers()[0].srcAccessMask == VK_ACCESS_TRANSFER_WRITE_BIT);
+	assert(tracker.PendingBarriers()[0].oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	assert(tracker.PendingBarriers()[0].newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	assert(tracker.Layout(a) == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	// Discard transitions from UNDEFINED, and shares the batch with the other image
+	tracker.Import(b, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT);
+	tracker.Transition(b, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, true);
+	assert(tracker.PendingBarriers().size() == 2);
+	assert(tracker.PendingBarriers()[1].oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+	assert(tracker.PendingBarriers()[1].subresourceRange.aspectMask == VK_IMAGE_ASPECT_DEPTH_BIT);
+	tracker.Flush(VK_NULL_HANDLE);
+	assert(gCalls == 2 && gBarriers.size() == 2);
+	assert(tracker.BarrierCount() == 3 && tracker.BatchCount() == 2);
+
+	printf("ImageStateTrackerTest passed\n");
+	return 0;
+}
\ No newline at end of file
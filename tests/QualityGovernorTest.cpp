@@ -0,0 +1,58 @@
+#undef NDEBUG
+#include "../QualityGovernor.hpp"
+
+#include <cassert>
+#include <cstdio>
+
+// Feeds the same timings for a number of frames, returns how many of them changed the level
+static uint32_t Feed(QualityGovernor& governor, uint32_t frames, float frameMs, float gpuMs, float budgetMs, float waitMs = 0) {
+	uint32_t changes = 0;
+	for (uint32_t i = 0; i < frames; i++)
+		if (governor.Update(frameMs, waitMs, gpuMs, budgetMs)) changes++;
+	return changes;
+}
+
+int main() {
+	const float budget = 10.f;
+	QualityGovernor governor;
+	governor.Ladder({
+		{ "High", 30.f, 1, true },
+		{ "Medium", 15.f, 1, true },
+		{ "Low", 5.f, 1, false },
+	});
+	governor.Thresholds(.9f, .7f);
+	governor.RecoveryFrames(20);
+
+	// Steps down as soon as one window averages over 90% of the budget, on either CPU or GPU
+	assert(Feed(governor, 7, 9.5f, 1.f, budget) == 0 && governor.LevelIndex() == 0);
+	assert(governor.Update(9.5f, 0, 1.f, budget) && governor.LevelIndex() == 1);
+	assert(Feed(governor, 8, 1.f, 9.5f, budget) == 1 && governor.LevelIndex() == 2);
+	// Nothing below the cheapest level
+	assert(Feed(governor, 32, 9.5f, 9.5f, budget) == 0 && governor.LevelIndex() == 2);
+
+	// Recovers only after RecoveryFrames consecutive frames under 70% of the budget
+	governor.Ladder({
+		{ "High", 30.f, 1, true },
+		{ "Low", 5.f, 1, false },
+	});
+	assert(Feed(governor, 8, 9.5f, 1.f, budget) == 1 && governor.LevelIndex() == 1);
+	// The new level fills its window first, then counts 11 frames of headroom
+	assert(Feed(governor, 8 + 10, 5.f, 5.f, budget) == 0 && governor.LevelIndex() == 1);
+	// Once the average climbs between the thresholds the count restarts...
+	assert(Feed(governor, 8, 8.f, 8.f, budget) == 0 && governor.LevelIndex() == 1);
+	// ...and the average is back under 70% from the third frame on, so the 20th frame of headroom is the 22nd here
+	assert(Feed(governor, 21, 5.f, 5.f, budget) == 0 && governor.LevelIndex() == 1);
+	assert(governor.Update(5.f, 0, 5.f, budget) && governor.LevelIndex() == 0);
+
+	// Time blocked on the compositor's pose wait is not CPU work: a frame mostly spent waiting keeps the level...
+	assert(Feed(governor, 32, 9.5f, 5.f, budget, 8.f) == 0 && governor.LevelIndex() == 0);
+	// ...while the same frame time spent working steps down
+	assert(Feed(governor, 8, 9.5f, 5.f, budget) == 1 && governor.LevelIndex() == 1);
+
+	// Disabled, nothing changes
+	governor.Enabled(false);
+	assert(Feed(governor, 32, 20.f, 20.f, budget) == 0 && governor.LevelIndex() == 1);
+
+	printf("QualityGovernorTest passed\n");
+	return 0;
+}
\ No newline at end of file